@@ -0,0 +1,201 @@
+#ifndef _WIN32
+
+#include <sstream>
+#include <cassert>
+#include <cctype>
+#include <set>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+#include "aotcompiler.h"
+#include "aotengine.h"
+
+namespace
+{
+    // Labels can hold anything a string can so keep what
+    // is valid in an identifier and replace the rest
+    std::string GetIdentifier(const std::string& label)
+    {
+        std::string ident;
+        for(unsigned char c : label)
+        {
+            ident += std::isalnum(c) ? c : '_';
+        }
+        return ident;
+    }
+}
+
+namespace Exys
+{
+
+AotCompiler::AotCompiler(std::unique_ptr<Jitter> jitter)
+: mJitter(std::move(jitter))
+{
+}
+
+AotCompiler::~AotCompiler()
+{
+}
+
+// Read back by AotEngine::LoadLayout
+std::string AotCompiler::BuildLayout() const
+{
+    const auto& inputDesc = mJitter->GetInputDesc();
+    const auto& observerDesc = mJitter->GetObserverDesc();
+
+    std::stringstream layout;
+    layout << "inputs " << inputDesc.size() << "\n";
+    layout << "observers " << observerDesc.size() << "\n";
+    layout << "state " << mJitter->GetStateSpaceSize() << "\n";
+    for(const auto& target : mJitter->GetSimFuncTargets())
+    {
+        layout << "sim " << target << "\n";
+    }
+    for(const auto& id : inputDesc)
+    {
+        for(const auto& label : id->mInputLabels)
+        {
+            layout << "input " << id->mInputOffset << " " << id->mLength << " " << label << "\n";
+        }
+    }
+    for(const auto& od : observerDesc)
+    {
+        for(const auto& label : od->mObserverLabels)
+        {
+            layout << "observer " << od->mObserverOffset << " " << od->mLength << " " << label << "\n";
+        }
+    }
+    return layout.str();
+}
+
+std::string AotCompiler::GetHeader(const std::string& name) const
+{
+    const auto& inputDesc = mJitter->GetInputDesc();
+    const auto& observerDesc = mJitter->GetObserverDesc();
+
+    std::stringstream header;
+    header << "// Generated by exysaot. Do not edit\n"
+           << "#pragma once\n\n"
+           << "#include \"exys.h\"\n\n"
+           << "namespace " << GetIdentifier(name) << "\n{\n\n"
+           << "constexpr int INPUT_COUNT = " << inputDesc.size() << ";\n"
+           << "constexpr int OBSERVER_COUNT = " << observerDesc.size() << ";\n"
+           << "constexpr int STATE_SIZE = " << mJitter->GetStateSpaceSize() << ";\n"
+           << "constexpr int SIM_FUNC_COUNT = " << mJitter->GetSimFuncCount() << ";\n\n";
+
+    // Labels that only differ by characters that aren't valid
+    // in an identifier get the offset added to keep them apart
+    std::set<std::string> labels;
+    std::set<std::string> idents;
+    auto addOffset = [&](const std::string& prefix, const std::string& label, int offset, int length)
+    {
+        if(!labels.insert(prefix + label).second) return;
+        auto ident = prefix + GetIdentifier(label);
+        if(!idents.insert(ident).second)
+        {
+            ident += "_" + std::to_string(offset);
+            idents.insert(ident);
+        }
+        header << "constexpr int " << ident << " = " << offset << "; // \"" << label << "\"";
+        if(length > 1) header << " length " << length;
+        header << "\n";
+    };
+
+    header << "// Offsets into the input points\n";
+    for(const auto& id : inputDesc)
+    {
+        for(const auto& label : id->mInputLabels)
+        {
+            addOffset("INPUT_", label, id->mInputOffset, id->mLength);
+        }
+    }
+    header << "\n// Offsets into the observer points\n";
+    for(const auto& od : observerDesc)
+    {
+        for(const auto& label : od->mObserverLabels)
+        {
+            addOffset("OBSERVER_", label, od->mObserverOffset, od->mLength);
+        }
+    }
+
+    header << "\n}\n\n"
+           << "extern \"C\"\n{\n"
+           << "void " << AOT_INIT_NAME << "(double* state);\n"
+           << "void " << AOT_STAB_NAME << "(Exys::Point* inputs, Exys::Point* observers, double* state);\n";
+    if(mJitter->GetSimFuncCount() > 0)
+    {
+        header << "void " << AOT_SIM_NAME
+               << "(Exys::Point* inputs, Exys::Point* inputsAndDone, double* state, int simId);\n";
+    }
+    header << "}\n";
+    return header.str();
+}
+
+void AotCompiler::CompleteBuild(const std::string& cpu)
+{
+    InitializeHostTarget();
+
+    auto module = mJitter->BuildModule();
+    auto* M = module.get();
+
+    std::string err;
+    const auto triple = llvm::sys::getProcessTriple();
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, err);
+    if(!target)
+    {
+        throw GraphBuildException(err, Cell());
+    }
+
+    std::string targetCpu = cpu;
+    std::string features;
+    if(targetCpu.empty())
+    {
+        targetCpu = llvm::sys::getHostCPUName().str();
+        for(const auto& feature : GetHostCpuFeatures())
+        {
+            if(!features.empty()) features += ",";
+            features += feature;
+        }
+    }
+
+    // Position independent so it can go in a shared library
+    std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(triple, targetCpu, features,
+            llvm::TargetOptions(), llvm::Reloc::PIC_, llvm::CodeModel::Default, llvm::CodeGenOpt::Aggressive));
+    M->setDataLayout(machine->createDataLayout());
+    M->setTargetTriple(triple);
+
+    // The descriptors go in the object so the engine only needs the library
+    mLayout = BuildLayout();
+    auto* layoutData = llvm::ConstantDataArray::getString(M->getContext(), mLayout);
+    new llvm::GlobalVariable(*M, layoutData->getType(), true,
+            llvm::GlobalValue::ExternalLinkage, layoutData, AOT_LAYOUT_NAME);
+
+    llvm::SmallVector<char, 0> object;
+    llvm::raw_svector_ostream out(object);
+    llvm::legacy::PassManager PM;
+    if(machine->addPassesToEmitFile(PM, out, llvm::TargetMachine::CGFT_ObjectFile))
+    {
+        throw GraphBuildException("Target can't emit object files", Cell());
+    }
+    PM.run(*M);
+    mObject.assign(object.begin(), object.end());
+}
+
+std::unique_ptr<AotCompiler> AotCompiler::Build(const std::string& text, const std::string& cpu)
+{
+    auto jitter = Jitter::Build(text);
+    auto compiler = std::unique_ptr<AotCompiler>(new AotCompiler(std::move(jitter)));
+    compiler->CompleteBuild(cpu);
+    return compiler;
+}
+
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _WIN32
+#pragma once
+
+#include <string>
+#include <memory>
+
+#include "exys.h"
+#include "jitter.h"
+
+namespace Exys
+{
+
+// Compiles a graph to an object file ahead of time so it can be
+// linked into a shared library and loaded by AotEngine without LLVM
+class AotCompiler
+{
+public:
+    AotCompiler(std::unique_ptr<Jitter> jitter);
+    virtual ~AotCompiler();
+
+    const std::string& GetObject() const { return mObject; }
+    const std::string& GetLayout() const { return mLayout; }
+
+    // C++ header with the point offsets and the exported functions
+    std::string GetHeader(const std::string& name) const;
+
+    // cpu is an llvm cpu name. Empty generates code for the host
+    static std::unique_ptr<AotCompiler> Build(const std::string& text, const std::string& cpu);
+
+private:
+    void CompleteBuild(const std::string& cpu);
+    std::string BuildLayout() const;
+
+    std::unique_ptr<Jitter> mJitter;
+    std::string mObject;
+    std::string mLayout;
+};
+
+};
+#endif
@@ -0,0 +1,135 @@
+#ifndef _WIN32
+
+#include <sstream>
+#include <cassert>
+#include <dlfcn.h>
+
+#include "aotengine.h"
+
+namespace Exys
+{
+
+AotEngine::AotEngine(void* library)
+: mLibrary(library)
+{
+}
+
+AotEngine::~AotEngine()
+{
+    if(mLibrary) dlclose(mLibrary);
+}
+
+std::string AotEngine::GetDOTGraph() const
+{
+    return "";
+}
+
+void* AotEngine::LookupSymbol(const char* name) const
+{
+    void* symbol = dlsym(mLibrary, name);
+    if(!symbol)
+    {
+        std::stringstream err;
+        err << "Compiled graph is missing " << name;
+        throw GraphBuildException(err.str(), Cell());
+    }
+    return symbol;
+}
+
+// Written by AotCompiler::BuildLayout one description per line
+void AotEngine::LoadLayout(const std::string& layout)
+{
+    std::istringstream lines(layout);
+    std::string line;
+    int observerSize = 0;
+    while(std::getline(lines, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        if(kind == "inputs")
+        {
+            fields >> mInputSize;
+            mPoints.resize(mInputSize + observerSize);
+        }
+        else if(kind == "observers")
+        {
+            fields >> observerSize;
+            mPoints.resize(mInputSize + observerSize);
+        }
+        else if(kind == "state")
+        {
+            int stateSize = 0;
+            fields >> stateSize;
+            mState.resize(stateSize);
+        }
+        else if(kind == "sim")
+        {
+            std::string target;
+            fields >> std::ws;
+            std::getline(fields, target);
+            mSimFuncTargets.push_back(target);
+        }
+        else if(kind == "input" || kind == "observer")
+        {
+            int offset = 0;
+            uint32_t length = 1;
+            std::string label;
+            fields >> offset >> length >> std::ws;
+            std::getline(fields, label);
+
+            const bool isInput = kind == "input";
+            if(!isInput) offset += mInputSize;
+            if(fields.fail() || offset < 0 || offset >= (int)mPoints.size())
+            {
+                throw GraphBuildException("Compiled graph has a bad layout - " + line, Cell());
+            }
+            (isInput ? mLabels->mInputOffsets : mLabels->mObserverOffsets)[label] = offset;
+            mPoints[offset].mLength = length;
+        }
+    }
+    mSimFuncCount = mSimFuncTargets.size();
+}
+
+void AotEngine::CompleteLoad()
+{
+    mInitFunc = reinterpret_cast<InitFunc>(LookupSymbol(AOT_INIT_NAME));
+    mRawStabilizeFunc = reinterpret_cast<StabilizationFunc>(LookupSymbol(AOT_STAB_NAME));
+    LoadLayout(reinterpret_cast<const char*>(LookupSymbol(AOT_LAYOUT_NAME)));
+    if(mSimFuncCount > 0)
+    {
+        mRawSimFunc = reinterpret_cast<SimFunc>(LookupSymbol(AOT_SIM_NAME));
+    }
+
+    mBatchStamps.resize(mInputSize);
+    mInitFunc(mState.data());
+    SetPointPtrs();
+
+    Stabilize(true);
+}
+
+std::string AotEngine::GetNumSimulationTarget(int simId) const
+{
+    if(simId < (int)mSimFuncTargets.size())
+    {
+        return mSimFuncTargets[simId];
+    }
+
+    return "";
+}
+
+std::unique_ptr<IEngine> AotEngine::Load(const std::string& path)
+{
+    void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if(!library)
+    {
+        throw GraphBuildException(dlerror(), Cell());
+    }
+    auto engine = std::unique_ptr<AotEngine>(new AotEngine(library));
+    engine->CompleteLoad();
+    return std::unique_ptr<IEngine>(std::move(engine));
+}
+
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef _WIN32
+#pragma once
+
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+#include "exys.h"
+#include "pointengine.h"
+
+namespace Exys
+{
+
+// Symbols exported by a graph compiled ahead of time. The
+// function names must match the ones in jitter.h
+constexpr char AOT_INIT_NAME[] = "ExysInit";
+constexpr char AOT_STAB_NAME[] = "ExysStabilize";
+constexpr char AOT_SIM_NAME[] = "ExysSim";
+constexpr char AOT_LAYOUT_NAME[] = "ExysLayout";
+
+// Runs a graph compiled by exysaot from a shared library. Doesn't
+// need LLVM so the host pays nothing for compilation at startup
+class AotEngine : public CompiledEngine
+{
+public:
+    AotEngine(void* library);
+    virtual ~AotEngine();
+
+    std::string GetNumSimulationTarget(int simId) const override;
+
+    std::string GetDOTGraph() const override;
+
+    static std::unique_ptr<IEngine> Load(const std::string& path);
+
+private:
+    void* LookupSymbol(const char* name) const;
+    void LoadLayout(const std::string& layout);
+    void CompleteLoad();
+
+    void* mLibrary = nullptr;
+    std::vector<std::string> mSimFuncTargets;
+};
+
+};
+#endif
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "enginestats.h"
+
+namespace Exys
+{
+
+namespace
+{
+    // Only the recording thread writes so a plain load and
+    // store is enough and avoids a locked instruction
+    inline void Add(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+}
+
+StatsHistogram::StatsHistogram()
+{
+    Reset();
+}
+
+size_t StatsHistogram::GetBucket(uint64_t value)
+{
+    value = std::min<uint64_t>(value, (uint64_t(1) << MAX_VALUE_BITS) - 1);
+    if(value < SUB_BUCKETS) return value;
+
+    int topBit = 63;
+    while(!(value >> topBit)) --topBit;
+    const int shift = topBit - SUB_BUCKET_BITS;
+    const auto sub = (value >> shift) - SUB_BUCKETS;
+    return SUB_BUCKETS * (shift + 1) + sub;
+}
+
+uint64_t StatsHistogram::GetBucketTop(size_t bucket)
+{
+    if(bucket < SUB_BUCKETS) return bucket;
+
+    const int shift = bucket / SUB_BUCKETS - 1;
+    const uint64_t sub = bucket % SUB_BUCKETS + SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void StatsHistogram::Record(uint64_t value)
+{
+    Add(mBuckets[GetBucket(value)], 1);
+    Add(mCount, 1);
+    Add(mSum, value);
+    if(value < mMin.load(std::memory_order_relaxed)) mMin.store(value, std::memory_order_relaxed);
+    if(value > mMax.load(std::memory_order_relaxed)) mMax.store(value, std::memory_order_relaxed);
+}
+
+void StatsHistogram::Reset()
+{
+    for(auto& bucket : mBuckets) bucket.store(0, std::memory_order_relaxed);
+    mCount.store(0, std::memory_order_relaxed);
+    mSum.store(0, std::memory_order_relaxed);
+    mMin.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    mMax.store(0, std::memory_order_relaxed);
+}
+
+uint64_t StatsHistogram::GetPercentile(uint64_t count, double percentile) const
+{
+    const auto rank = std::max<uint64_t>(1, std::ceil(count * percentile));
+    uint64_t seen = 0;
+    for(size_t bucket = 0; bucket < mBuckets.size(); ++bucket)
+    {
+        seen += mBuckets[bucket].load(std::memory_order_relaxed);
+        if(seen >= rank) return GetBucketTop(bucket);
+    }
+    return mMax.load(std::memory_order_relaxed);
+}
+
+// Read while recording carries on so the fields can be a
+// few records apart. Percentiles are capped at the max
+StatsSummary StatsHistogram::GetSummary() const
+{
+    StatsSummary summary;
+    summary.mCount = mCount.load(std::memory_order_relaxed);
+    if(!summary.mCount) return summary;
+
+    summary.mMin = mMin.load(std::memory_order_relaxed);
+    summary.mMax = mMax.load(std::memory_order_relaxed);
+    summary.mMean = mSum.load(std::memory_order_relaxed) / summary.mCount;
+    summary.mP50 = std::min(summary.mMax, GetPercentile(summary.mCount, 0.5));
+    summary.mP90 = std::min(summary.mMax, GetPercentile(summary.mCount, 0.9));
+    summary.mP99 = std::min(summary.mMax, GetPercentile(summary.mCount, 0.99));
+    summary.mP999 = std::min(summary.mMax, GetPercentile(summary.mCount, 0.999));
+    return summary;
+}
+
+void StatsRecorder::Enable(bool enable)
+{
+    if(enable && !mHistograms)
+    {
+        mHistograms.reset(new Histograms);
+    }
+    mEnabled = enable;
+}
+
+void StatsRecorder::Reset()
+{
+    if(!mHistograms) return;
+    mHistograms->mStabilizeNanos.Reset();
+    mHistograms->mNodesRecomputed.Reset();
+    mHistograms->mDirtyInputs.Reset();
+    mHistograms->mSimulationNanos.Reset();
+}
+
+EngineStats StatsRecorder::GetStats() const
+{
+    EngineStats stats;
+    if(!mHistograms) return stats;
+    stats.mStabilizeNanos = mHistograms->mStabilizeNanos.GetSummary();
+    stats.mNodesRecomputed = mHistograms->mNodesRecomputed.GetSummary();
+    stats.mDirtyInputs = mHistograms->mDirtyInputs.GetSummary();
+    stats.mSimulationNanos = mHistograms->mSimulationNanos.GetSummary();
+    return stats;
+}
+
+void StatsRecorder::RecordStabilize(uint64_t nanos, uint64_t dirtyInputs)
+{
+    mHistograms->mStabilizeNanos.Record(nanos);
+    mHistograms->mDirtyInputs.Record(dirtyInputs);
+}
+
+void StatsRecorder::RecordStabilize(uint64_t nanos, uint64_t dirtyInputs, uint64_t nodesRecomputed)
+{
+    RecordStabilize(nanos, dirtyInputs);
+    mHistograms->mNodesRecomputed.Record(nodesRecomputed);
+}
+
+void StatsRecorder::RecordSimulation(uint64_t nanos)
+{
+    mHistograms->mSimulationNanos.Record(nanos);
+}
+
+uint64_t StatsRecorder::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
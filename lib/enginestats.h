@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <memory>
+
+#include "exys.h"
+
+namespace Exys
+{
+
+// Log linear buckets in the style of HdrHistogram. Values below 32 get
+// a bucket each and every power of two above is split into 32 so the
+// bucket a value lands in is never more than 1/32 wider than it. Values
+// past 2^40 are clamped. One thread records and any thread can read
+class StatsHistogram
+{
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_VALUE_BITS = 40;
+    static constexpr int NUM_BUCKETS = SUB_BUCKETS * (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1);
+
+    StatsHistogram();
+
+    void Record(uint64_t value);
+    void Reset();
+    StatsSummary GetSummary() const;
+
+    static size_t GetBucket(uint64_t value);
+    static uint64_t GetBucketTop(size_t bucket);
+
+private:
+    uint64_t GetPercentile(uint64_t count, double percentile) const;
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> mBuckets;
+    std::atomic<uint64_t> mCount;
+    std::atomic<uint64_t> mSum;
+    std::atomic<uint64_t> mMin;
+    std::atomic<uint64_t> mMax;
+};
+
+// Held by each engine. The histograms are only allocated when stats
+// are first enabled so engines that never use them pay a null pointer
+class StatsRecorder
+{
+public:
+    bool IsEnabled() const { return mEnabled; }
+    void Enable(bool enable);
+    void Reset();
+    EngineStats GetStats() const;
+
+    void RecordStabilize(uint64_t nanos, uint64_t dirtyInputs);
+    void RecordStabilize(uint64_t nanos, uint64_t dirtyInputs, uint64_t nodesRecomputed);
+    void RecordSimulation(uint64_t nanos);
+
+    static uint64_t Now();
+
+private:
+    struct Histograms
+    {
+        StatsHistogram mStabilizeNanos;
+        StatsHistogram mNodesRecomputed;
+        StatsHistogram mDirtyInputs;
+        StatsHistogram mSimulationNanos;
+    };
+
+    bool mEnabled = false;
+    std::unique_ptr<Histograms> mHistograms;
+};
+
+}
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <map>
 #include <algorithm>
+#include <cmath>
 
 namespace Exys
 {
@@ -20,12 +21,12 @@ inline std::vector<Cell> GetTests(const std::string& text)
         {
             return ret;
         }
-        for(const auto& c : cell.list)
+        for(auto& c : cell.list)
         {
             const auto& l = c.list;
             if(l.size() > 1 && l[0].details.text == "test")
             {
-                ret.push_back(c);
+                ret.push_back(std::move(c));
             }
         }
     }
@@ -38,6 +39,53 @@ struct GraphState
     std::map<std::string, std::vector<double>> observers;
 };
 
+// Within epsilon like Point compares, with NaN only matching NaN
+inline bool SameValue(double actual, double expected)
+{
+    if(std::isnan(actual) || std::isnan(expected)) return std::isnan(actual) && std::isnan(expected);
+    return !(std::abs(actual - expected) > Point::POINT_EPSILON);
+}
+
+inline void CompareValues(const std::map<std::string, std::vector<double>>& actual,
+        const std::map<std::string, std::vector<double>>& expected, std::string& differences)
+{
+    for(const auto& values : expected)
+    {
+        auto aiter = actual.find(values.first);
+        if(aiter == actual.end())
+        {
+            differences += "Missing - " + values.first + "\n";
+            continue;
+        }
+        if(aiter->second.size() != values.second.size())
+        {
+            differences += "Recorded a different number of times - " + values.first + "\n";
+            continue;
+        }
+        for(size_t i = 0; i < values.second.size(); ++i)
+        {
+            if(!SameValue(aiter->second[i], values.second[i]))
+            {
+                differences += "Differs at record " + std::to_string(i) + " - " + values.first + " "
+                    + std::to_string(aiter->second[i]) + " expected " + std::to_string(values.second[i]) + "\n";
+            }
+        }
+    }
+    for(const auto& values : actual)
+    {
+        if(!expected.count(values.first)) differences += "Unexpected - " + values.first + "\n";
+    }
+}
+
+// What differs between two engines that ran the same tests. Empty if nothing
+inline std::string CompareStates(const GraphState& actual, const GraphState& expected)
+{
+    std::string differences;
+    CompareValues(actual.inputs, expected.inputs, differences);
+    CompareValues(actual.observers, expected.observers, differences);
+    return differences;
+}
+
 void GetNode(const Cell& cell, std::vector<double>& vals)
 {
     if(cell.type == Cell::Type::NUMBER)
@@ -47,7 +95,7 @@ void GetNode(const Cell& cell, std::vector<double>& vals)
     }
     else if(cell.type == Cell::Type::LIST)
     {
-        for(auto c : cell.list)
+        for(const auto& c : cell.list)
         {
             GetNode(c, vals);
         }
@@ -56,11 +104,34 @@ void GetNode(const Cell& cell, std::vector<double>& vals)
     assert(false);
 }
 
+// Points are dumped into the same vectors every time so the engine
+// doesn't build fresh labels after every stabilize
+struct DumpedPoints
+{
+    std::vector<std::pair<std::string, double>> inputs;
+    std::vector<std::pair<std::string, double>> observers;
+};
+
+inline void RecordState(IEngine& exysInstance, GraphState& state, DumpedPoints& dumped)
+{
+    exysInstance.DumpInputs(dumped.inputs);
+    for(const auto& input : dumped.inputs)
+    {
+        state.inputs[input.first].push_back(input.second);
+    }
+    exysInstance.DumpObservers(dumped.observers);
+    for(const auto& observer : dumped.observers)
+    {
+        state.observers[observer.first].push_back(observer.second);
+    }
+}
+
 inline std::tuple<bool, std::string, std::string> RunTest(IEngine& exysInstance, Cell test, GraphState& state)
 {
     bool ret = true;
     std::string testname = test.list[1].details.text;
     std::string resultStr;
+    DumpedPoints dumped;
     assert(test.list.size() > 2 && "Not enough args for test case");
     
     for(auto l = test.list.begin()+2; l != test.list.end(); ++l)
@@ -88,21 +159,22 @@ inline std::tuple<bool, std::string, std::string> RunTest(IEngine& exysInstance,
 			}
 
             const auto& label = l->list[1].details.text;
-            if(!exysInstance.HasInputPoint(label))
+            const auto handle = exysInstance.ResolveInput(label);
+            if(!handle.IsValid())
             {
 				ret &= false;
 				resultStr += "Unrecognised input - " + label;
 				break;
 			}
 
-			auto& p = exysInstance.LookupInputPoint(label);
 			auto val = l->list[2];
 			if(val.type == Cell::Type::NUMBER)
 			{
-				p = std::stod(val.details.text);
+				exysInstance.SetInput(handle, std::stod(val.details.text));
 			}
 			else if(val.type == Cell::Type::LIST)
 			{
+				auto& p = exysInstance.LookupInputPoint(handle);
 				std::vector<double> nodeVals;
 				GetNode(val, nodeVals);
 				int i = 0;
@@ -115,14 +187,34 @@ inline std::tuple<bool, std::string, std::string> RunTest(IEngine& exysInstance,
         else if(firstElem.details.text == "stabilize")
         {
             exysInstance.Stabilize();
-            for(const auto& input : exysInstance.DumpInputs())
-            {
-                state.inputs[input.first].push_back(input.second);
-            }
-            for(const auto& observer : exysInstance.DumpObservers())
+            RecordState(exysInstance, state, dumped);
+        }
+        else if(firstElem.details.text == "batch")
+        {
+            std::vector<InputUpdate> updates;
+            for(auto u = l->list.begin()+1; u != l->list.end(); ++u)
             {
-                state.observers[observer.first].push_back(observer.second);
+                if((u->list.size() != 2) || (u->list[1].type != Cell::Type::NUMBER))
+                {
+                    ret &= false;
+                    resultStr += "Batch updates should be (label value)\n";
+                    break;
+                }
+
+                const auto& label = u->list[0].details.text;
+                const auto handle = exysInstance.ResolveInput(label);
+                if(!handle.IsValid())
+                {
+                    ret &= false;
+                    resultStr += "Unrecognised input - " + label;
+                    break;
+                }
+                updates.push_back({handle, std::stod(u->list[1].details.text)});
             }
+            if(!ret) break;
+
+            exysInstance.ApplyBatch(updates.data(), updates.size());
+            RecordState(exysInstance, state, dumped);
         }
         else if(firstElem.details.text == "sim-capture")
         {
@@ -196,21 +288,23 @@ inline std::tuple<bool, std::string, std::string> RunTest(IEngine& exysInstance,
                 resultStr += "Value checked before stabilization - " + label + "==" + l->list[2].details.text + "\n";
             }
 
-            if(exysInstance.HasObserverPoint(label))
+            const auto handle = exysInstance.ResolveObserver(label);
+            if(handle.IsValid())
             {
-                auto& p = exysInstance.LookupObserverPoint(label);
                 auto val = l->list[2];
                 if(val.type == Cell::Type::NUMBER)
                 {
-                    if(p != std::stod(val.details.text))
+                    const auto actual = exysInstance.ReadObserver(handle);
+                    if(!SameValue(actual, std::stod(val.details.text)))
                     {
                         ret &= false;
                         resultStr += "Value does not meet expectation - " + label + "!=" 
-                            + val.details.text + " actual " + std::to_string(p.mVal) + "\n";
+                            + val.details.text + " actual " + std::to_string(actual) + "\n";
                     }
                 }
                 else if(val.type == Cell::Type::LIST)
                 {
+                    auto& p = exysInstance.LookupObserverPoint(handle);
                     std::vector<double> nodeVals;
                     GetNode(val, nodeVals);
                     int i = 0;
@@ -243,7 +337,7 @@ inline std::tuple<bool, std::string, GraphState> Execute(IEngine& exysInstance,
     GraphState state;
 
     const auto tests = GetTests(text);
-    for(const auto test : tests)
+    for(const auto& test : tests)
     {
         bool success = false;
         std::string testname;
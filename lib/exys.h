@@ -7,6 +7,7 @@
 #include <unordered_map>
 #include <cassert>
 #include <cmath>
+#include <limits>
 
 #include "graph.h"
 
@@ -67,6 +68,51 @@ struct Point
 };
 #pragma pack(pop)
 
+// Resolved once from a label and then used to get at the point
+// without hashing the label. Only valid for the engine that
+// resolved it, and on copies of that engine
+template<typename Tag>
+struct PointHandle
+{
+    static constexpr uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+    uint32_t mIndex = INVALID;
+
+    bool IsValid() const { return mIndex != INVALID; }
+};
+typedef PointHandle<struct InputTag> InputHandle;
+typedef PointHandle<struct ObserverTag> ObserverHandle;
+
+struct InputUpdate
+{
+    InputHandle mHandle;
+    double mVal;
+};
+
+// Distribution of a value recorded once per stabilize or simulation.
+// Percentiles are the top of the histogram bucket they fall in so can
+// read up to 1/32 high. Zero count means nothing was recorded
+struct StatsSummary
+{
+    uint64_t mCount = 0;
+    uint64_t mMin = 0;
+    uint64_t mMean = 0;
+    uint64_t mP50 = 0;
+    uint64_t mP90 = 0;
+    uint64_t mP99 = 0;
+    uint64_t mP999 = 0;
+    uint64_t mMax = 0;
+};
+
+// Times are wall clock nanoseconds. Engines that can't tell how many
+// nodes they recomputed, like the generated code, leave it empty
+struct EngineStats
+{
+    StatsSummary mStabilizeNanos;
+    StatsSummary mNodesRecomputed;
+    StatsSummary mDirtyInputs;
+    StatsSummary mSimulationNanos;
+};
+
 class IEngine
 {
 public:
@@ -79,11 +125,26 @@ public:
     virtual Point& LookupInputPoint(const std::string& label) = 0;
     virtual std::vector<std::string> GetInputPointLabels() const = 0;
     virtual std::vector<std::pair<std::string, double>> DumpInputs() const = 0;
+    // Refill a vector from an earlier call without allocating
+    virtual void DumpInputs(std::vector<std::pair<std::string, double>>& values) const = 0;
 
     virtual bool HasObserverPoint(const std::string& label) const = 0;
     virtual Point& LookupObserverPoint(const std::string& label) = 0;
     virtual std::vector<std::string> GetObserverPointLabels() const = 0;
     virtual std::vector<std::pair<std::string, double>> DumpObservers() const = 0;
+    virtual void DumpObservers(std::vector<std::pair<std::string, double>>& values) const = 0;
+
+    // Handles are invalid if the label doesn't exist
+    virtual InputHandle ResolveInput(const std::string& label) const = 0;
+    virtual Point& LookupInputPoint(InputHandle handle) = 0;
+    virtual void SetInput(InputHandle handle, double value) = 0;
+    virtual void SetInputs(const InputHandle* handles, const double* values, size_t count) = 0;
+    // Applies the last write to each input then stabilizes once
+    virtual void ApplyBatch(const InputUpdate* updates, size_t count) = 0;
+
+    virtual ObserverHandle ResolveObserver(const std::string& label) const = 0;
+    virtual Point& LookupObserverPoint(ObserverHandle handle) = 0;
+    virtual double ReadObserver(ObserverHandle handle) const = 0;
 
     virtual bool SupportSimulation() const = 0;
     virtual int GetNumSimulationFunctions() const = 0;
@@ -93,6 +154,13 @@ public:
     virtual std::string GetNumSimulationTarget(int simId) const = 0;
 
     virtual std::string GetDOTGraph() const = 0;
+
+    // Off by default and a single branch per stabilize while off. Turn
+    // on and reset from the thread that stabilizes, before any other
+    // thread calls GetStats. Recording takes no locks
+    virtual void EnableStats(bool enable) = 0;
+    virtual void ResetStats() = 0;
+    virtual EngineStats GetStats() const = 0;
 };
 
 };
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+#include "exys.h"
+#include "aotcompiler.h"
+
+// Compiles a graph to an object file and a header describing its
+// points. Link the object into a shared library for AotEngine
+int main(int argc, char* argv[])
+{
+    // Default to code any cpu of the target can run as the
+    // library usually runs somewhere other than where it is built
+    std::string cpu = "generic";
+    std::string name = "exysgraph";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c': cpu = optarg; break;
+            case 'n': name = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-c cpu|native] [-n namespace] graph object header\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if(argc - optind != 3)
+    {
+        fprintf(stderr, "Usage: %s [-c cpu|native] [-n namespace] graph object header\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if(cpu == "native") cpu.clear();
+
+    std::ifstream t(argv[optind]);
+    if(!t.good())
+    {
+        std::cerr << "Failed to open " << argv[optind] << "\n";
+        return -1;
+    }
+    std::stringstream buffer;
+    buffer << t.rdbuf();
+
+    try
+    {
+        auto compiler = Exys::AotCompiler::Build(buffer.str(), cpu);
+
+        std::ofstream object(argv[optind+1], std::ios::binary);
+        object << compiler->GetObject();
+        std::ofstream header(argv[optind+2]);
+        header << compiler->GetHeader(name);
+        if(!object.good() || !header.good())
+        {
+            std::cerr << "Failed to write output\n";
+            return -1;
+        }
+    }
+    catch (const Exys::ParseException& e)
+    {
+        std::cerr << e.GetErrorMessage(buffer.str());
+        return -1;
+    }
+    catch (const Exys::GraphBuildException& e)
+    {
+        std::cerr << e.GetErrorMessage(buffer.str());
+        return -1;
+    }
+
+    return 0;
+}
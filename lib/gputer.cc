@@ -36,6 +36,8 @@ void Gputer::CompleteBuild()
     LLVMInitializeNVPTXTargetInfo();
     LLVMInitializeNVPTXTargetMC();
 
+    // Kernels don't track dirty inputs so compute everything
+    mJitter->SetIncremental(false);
     auto module = mJitter->BuildModule();
     auto* M = module.get();
 
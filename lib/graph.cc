@@ -1,19 +1,18 @@
 
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <set>
+#include <map>
+#include <unordered_set>
 #include <algorithm>
 
 #include "graph.h"
 #include "helpers.h"
-#include "std/stdlib.h"
-
-namespace
-{
-    constexpr char EXYS_REQUIRE_PATH[] = "EXYS_REQUIRE_PATH";
-}
+#include "modulecache.h"
 
 namespace Exys
 {
@@ -36,7 +35,7 @@ void ValidateListLength(const Cell& cell, size_t min, size_t max=std::numeric_li
     }
 }
 
-void ValidateParamListLength(const std::vector<Cell> params1, const Node::Ptr node)
+void ValidateParamListLength(const std::vector<Cell>& params1, const Node::Ptr node)
 {
     if(params1.size() != node->mParents.size())
     {
@@ -383,64 +382,45 @@ Node::Ptr Graph::Format(Node::Ptr node)
     return fstr;
 }
 
-bool SearchForFile(const std::string& name, std::string& out)
+Node::Ptr Graph::Require(Node::Ptr node)
 {
-    std::stringstream buffer;
-    char* searchPath = getenv(EXYS_REQUIRE_PATH);
-    std::string sp = searchPath != nullptr ? std::string(searchPath) : std::string();
-    std::stringstream ss(sp);
-    std::string path;
-    auto t = std::unique_ptr<std::ifstream>(new std::ifstream(name));
-    while(!t->good() && searchPath && std::getline(ss, path, ':'))
-    {
-        auto t = std::unique_ptr<std::ifstream>(new std::ifstream(path+"/"+name));
-    }
-
-    if(t->good())
-    {
-        buffer << t->rdbuf();
-        out = buffer.str();
-        return true;
-    }
+    ValidateFunctionArgs("require", node, {KIND_STR});
+    const auto& fname = node->mParents[0]->mToken;
 
-    for(size_t i = 0; i < sizeof(StdLibEntries) / sizeof(StdLibEntries[0]); ++i)
+    // A file required again while building the same graph gets the
+    // definitions it provided the first time
+    auto* root = this;
+    while(root->mParent) root = root->mParent;
+    auto it = root->mModules.find(fname);
+    if(it == root->mModules.end())
     {
-        if(StdLibEntries[i].name == name)
+        auto module = ModuleCache::Get().Load(fname);
+        if(!module)
         {
-            out = std::string((char*)StdLibEntries[i].data, StdLibEntries[i].len);
-            return true;
+            std::stringstream err;
+            err << "Cannot open required file to load " << 
+                node->mParents[0]->mToken << ". Check EXYS_REQUIRE_PATH variable";
+            throw GraphBuildException(err.str(), Cell());
         }
-    }
-    return false;
-}
 
-Node::Ptr Graph::Require(Node::Ptr node)
-{
-    ValidateFunctionArgs("require", node, {KIND_STR});
-    const auto& fname = node->mParents[0]->mToken;
-    std::string buffer;
-    if(!SearchForFile(fname, buffer))
-    {
-        std::stringstream err;
-        err << "Cannot open required file to load " << 
-            node->mParents[0]->mToken << ". Check EXYS_REQUIRE_PATH variable";
-        throw GraphBuildException(err.str(), Cell());
+        auto loadedGraph = BuildNode<Graph>(this);
+        try
+        {
+            loadedGraph->Construct(*module);
+        }
+        catch (Exys::GraphBuildException e)
+        {
+            e.mError = "From required file \"" + fname + "\" - "+ e.mError;
+            throw e;
+        }
+        it = root->mModules.emplace(fname, loadedGraph).first;
     }
 
-    auto loadedGraph = BuildNode<Graph>(this);
-    try
-    {
-        loadedGraph->Construct(Parse(buffer));
-    }
-    catch (Exys::GraphBuildException e)
-    {
-        e.mError = "From required file \"" + fname + "\" - "+ e.mError;
-        throw e;
-    }
-    for(auto pcell : loadedGraph->mProvidedNodes)
+    const auto& loaded = it->second;
+    for(const auto& pcell : loaded->mProvidedNodes)
     {
-        auto pnode = loadedGraph->LookupSymbol(pcell);
-        DefineNode(pcell.details.text, pnode);
+        auto pnode = loaded->LookupSymbol(pcell);
+        DefineNode(pcell.symbol, pnode);
     }
     return nullptr;
 }
@@ -450,7 +430,7 @@ Node::Ptr Graph::PrintLib(Node::Ptr node)
     ValidateFunctionArgs("print-lib", node, {KIND_STR});
     const auto& fname = node->mParents[0]->mToken;
     std::string buffer;
-    if(!SearchForFile(fname, buffer))
+    if(!ReadSource(fname, buffer))
     {
         std::stringstream err;
         err << "Cannot open required file to load " << 
@@ -463,29 +443,10 @@ Node::Ptr Graph::PrintLib(Node::Ptr node)
     return nullptr;
 }
 
-#define WRAP(__FUNC) \
-    [this](Node::Ptr ptr) -> Node::Ptr{return this->__FUNC(ptr);}
-
 Graph::Graph(Graph* parent)
 : Node(KIND_GRAPH) 
 , mParent(parent)
 {
-    AddProcFactory("for-each",  WRAP(ForEach));
-    AddProcFactory("map",       WRAP(Map));
-    AddProcFactory("fold",      WRAP(Fold));
-    AddProcFactory("list",      WRAP(List));
-    AddProcFactory("zip",       WRAP(Zip));
-    AddProcFactory("car",       WRAP(Car));
-    AddProcFactory("cdr",       WRAP(Cdr));
-    AddProcFactory("head",      WRAP(Car));
-    AddProcFactory("rest",      WRAP(Cdr));
-    AddProcFactory("iota",      WRAP(Iota));
-    AddProcFactory("apply",     WRAP(Apply));
-    AddProcFactory("append",    WRAP(Append));
-    AddProcFactory("nth",       WRAP(Nth));
-    AddProcFactory("format",    WRAP(Format));
-    AddProcFactory("require",   WRAP(Require));
-    AddProcFactory("print-lib", WRAP(PrintLib));
 }
 
 Graph::Graph(std::vector<Node::Ptr> nodes)
@@ -495,10 +456,68 @@ Graph::Graph(std::vector<Node::Ptr> nodes)
     mAllNodes.insert(mAllNodes.end(), nodes.begin(), nodes.end());
 }
 
+// Chains of nodes would release each other recursively and can run
+// out of stack. Nodes nothing else holds give up their parents first
+static void ReleaseNodes(std::vector<Node::Ptr>& nodes)
+{
+    std::vector<Node::Ptr> pending;
+    pending.swap(nodes);
+    while(pending.size())
+    {
+        auto node = std::move(pending.back());
+        pending.pop_back();
+        if(node.use_count() > 1) continue;
+        for(auto& parent : node->mParents) pending.push_back(std::move(parent));
+        node->mParents.clear();
+    }
+}
+
+Graph::~Graph()
+{
+    ReleaseNodes(mAllNodes);
+}
+
+// Every scope offers these. A scope only gets a factory for one the
+// first time it is looked up there, as lambda calls each get a scope
+Graph::BuiltinFunc Graph::GetBuiltin(Symbol symbol)
+{
+    static const std::unordered_map<Symbol, BuiltinFunc> builtins =
+    {
+        {SymbolTable::Get().Intern("for-each"),  &Graph::ForEach},
+        {SymbolTable::Get().Intern("map"),       &Graph::Map},
+        {SymbolTable::Get().Intern("fold"),      &Graph::Fold},
+        {SymbolTable::Get().Intern("list"),      &Graph::List},
+        {SymbolTable::Get().Intern("zip"),       &Graph::Zip},
+        {SymbolTable::Get().Intern("car"),       &Graph::Car},
+        {SymbolTable::Get().Intern("cdr"),       &Graph::Cdr},
+        {SymbolTable::Get().Intern("head"),      &Graph::Car},
+        {SymbolTable::Get().Intern("rest"),      &Graph::Cdr},
+        {SymbolTable::Get().Intern("iota"),      &Graph::Iota},
+        {SymbolTable::Get().Intern("apply"),     &Graph::Apply},
+        {SymbolTable::Get().Intern("append"),    &Graph::Append},
+        {SymbolTable::Get().Intern("nth"),       &Graph::Nth},
+        {SymbolTable::Get().Intern("format"),    &Graph::Format},
+        {SymbolTable::Get().Intern("require"),   &Graph::Require},
+        {SymbolTable::Get().Intern("print-lib"), &Graph::PrintLib}
+    };
+    auto biter = builtins.find(symbol);
+    return biter != builtins.end() ? biter->second : nullptr;
+}
+
+Node::Ptr Graph::BuildBuiltin(Symbol symbol)
+{
+    const auto builtin = GetBuiltin(symbol);
+    if(!builtin) return nullptr;
+    auto pnode = BuildNode<ProcNodeFactory>([this, builtin](Node::Ptr ptr){return (this->*builtin)(ptr);});
+    mVarNodes[symbol] = pnode;
+    return pnode;
+}
+
 template<typename T, typename... Args>
 std::shared_ptr<T> Graph::BuildNode(Args... as)
 {
     auto ret = std::make_shared<T>(as...);
+    ret->mDetails = mCurrentDetails;
     mAllNodes.push_back(ret);
     return ret;
 }
@@ -510,12 +529,13 @@ void Graph::SetSupportedProcedures(const std::vector<Procedure>& procs)
 
 ProcNodeFactoryFunc Graph::DefaultFactory(const Procedure& procedure)
 {
-    return [this, procedure](Node::Ptr node) -> Node::Ptr
+    const auto symbol = SymbolTable::Get().Intern(procedure.id);
+    return [this, procedure, symbol](Node::Ptr node) -> Node::Ptr
     {
         ValidateArgsNotNull(node);
         procedure.validate(node);
         auto mn = BuildNode(KIND_PROC);
-        mn->mToken = procedure.id;
+        mn->SetProcedure(symbol);
         for(auto& n : node->mParents)
         {
             mn->mParents.push_back(n);
@@ -528,16 +548,16 @@ void Graph::AddProcFactory(const std::string id, ProcNodeFactoryFunc factory)
 {
     auto pnode = BuildNode<ProcNodeFactory>(factory);
     assert(pnode && "Building factory returns null");
-    mVarNodes[id] = pnode;
+    mVarNodes[SymbolTable::Get().Intern(id)] = pnode;
 }
 
 void Graph::SetSymbol(const Cell& cell, Node::Ptr node)
 {
     assert(node);
-    auto niter = mVarNodes.find(cell.details.text);
-    if (niter != mVarNodes.end())
+    auto niter = mVarNodes.find(cell.symbol);
+    if (niter != mVarNodes.end() || GetBuiltin(cell.symbol))
     {
-        niter->second = node;
+        mVarNodes[cell.symbol] = node;
         return;
     }
     if(mParent) return mParent->SetSymbol(cell, node);
@@ -549,7 +569,7 @@ void Graph::SetSymbol(const Cell& cell, Node::Ptr node)
 
 Node::Ptr Graph::LookupSymbol(const Cell& cell)
 {
-    auto niter = mVarNodes.find(cell.details.text);
+    auto niter = mVarNodes.find(cell.symbol);
     if (niter != mVarNodes.end())
     {
         if(!niter->second)
@@ -560,6 +580,7 @@ Node::Ptr Graph::LookupSymbol(const Cell& cell)
         }
         return niter->second;
     }
+    if(auto builtin = BuildBuiltin(cell.symbol)) return builtin;
     if(mParent) return mParent->LookupSymbol(cell);
 
     std::stringstream err;
@@ -581,17 +602,17 @@ ProcNodeFactoryFunc Graph::LookupProcedure(const Cell& cell)
     return static_cast<ProcNodeFactory*>(node.get())->mFactory;
 }
 
-void Graph::DefineNode(const std::string& token, const Cell& exp)
+void Graph::DefineNode(Symbol symbol, const Cell& exp)
 {
     auto parent = Build(exp);
     assert(parent);
-    mVarNodes[token] = parent;
+    mVarNodes[symbol] = parent;
 }
 
-void Graph::DefineNode(const std::string& token, Node::Ptr node)
+void Graph::DefineNode(Symbol symbol, Node::Ptr node)
 {
     assert(node);
-    mVarNodes[token] = node;
+    mVarNodes[symbol] = node;
 }
 
 void Graph::BuildInputList(Node::Ptr child, const std::string& token, std::deque<int> dims)
@@ -609,7 +630,7 @@ void Graph::BuildInputList(Node::Ptr child, const std::string& token, std::deque
         interList->mInputLabels.push_back(interList->mToken);
 
         child->mParents.push_back(interList);
-        DefineNode(interList->mToken, interList);
+        DefineNode(SymbolTable::Get().Intern(interList->mToken), interList);
         BuildInputList(interList, interList->mToken, dims);
     }
 }
@@ -678,7 +699,7 @@ void Graph::Construct(const Cell &cell)
         for(const auto& c : cell.list)
         {
             const auto& l = c.list;
-            if(l.size() > 1 && l[0].details.text == "begin")
+            if(l.size() > 1 && l[0].symbol == SYMBOL_BEGIN)
             {
                 try
                 {
@@ -686,7 +707,7 @@ void Graph::Construct(const Cell &cell)
                 }
                 catch (Exys::GraphBuildException e)
                 {
-                    e.mCell = mCurrentCell;
+                    e.mCell.details = mCurrentDetails;
                     throw e;
                 }
                 return;
@@ -698,7 +719,7 @@ void Graph::Construct(const Cell &cell)
 
 Node::Ptr Graph::Build(const Cell &cell)
 {
-    mCurrentCell = cell;
+    mCurrentDetails = cell.details;
     Node::Ptr ret = nullptr;
     if(cell.type == Cell::Type::SYMBOL)
     {
@@ -706,7 +727,7 @@ Node::Ptr Graph::Build(const Cell &cell)
         if(ret->mKind == KIND_VAR)
         {
             auto loadVar = BuildNode(KIND_PROC);
-            loadVar->mToken = "load";
+            loadVar->SetProcedure(SYMBOL_LOAD);
             loadVar->mParents.push_back(ret);
             ret = loadVar;
         }
@@ -728,7 +749,7 @@ Node::Ptr Graph::Build(const Cell &cell)
         if (!cell.list.empty())
         {
             auto& firstElem = cell.list.front();
-            if(firstElem.details.text == "begin")
+            if(firstElem.symbol == SYMBOL_BEGIN)
             {
                 ValidateListLength(cell, 2);
 
@@ -737,17 +758,16 @@ Node::Ptr Graph::Build(const Cell &cell)
                     ret = Build(*c);
                 }
             }
-            else if(firstElem.details.text == "define")
+            else if(firstElem.symbol == SYMBOL_DEFINE)
             {
                 ValidateListLength(cell, 3);
 
-                auto& varToken = cell.list[1].details.text;
                 auto& exp = cell.list[2];
 
                 // Build parents and adopt their type
-                DefineNode(varToken, exp);
+                DefineNode(cell.list[1].symbol, exp);
             }
-            else if(firstElem.details.text == "defvar")
+            else if(firstElem.symbol == SYMBOL_DEFVAR)
             {
                 ValidateListLength(cell, 3);
 
@@ -758,9 +778,9 @@ Node::Ptr Graph::Build(const Cell &cell)
                 auto varNode = BuildNode(KIND_VAR);
                 varNode->mToken = varToken;
                 varNode->mInitValue = std::stod(exp.details.text);
-                DefineNode(varToken, varNode);
+                DefineNode(cell.list[1].symbol, varNode);
             }
-            else if(firstElem.details.text == "set!")
+            else if(firstElem.symbol == SYMBOL_SET)
             {
                 ValidateListLength(cell, 3);
 
@@ -775,7 +795,7 @@ Node::Ptr Graph::Build(const Cell &cell)
                 {
                     // Build parents and adopt their type
                     auto storeNode = BuildNode(KIND_PROC);
-                    storeNode->mToken = "store";
+                    storeNode->SetProcedure(SYMBOL_STORE);
                     storeNode->mForceKeep = true;
                     storeNode->mParents.push_back(sym);
                     storeNode->mParents.push_back(Build(exp));
@@ -789,7 +809,7 @@ Node::Ptr Graph::Build(const Cell &cell)
                     ret = parent;
                 }
             }
-            else if(firstElem.details.text == "lambda")
+            else if(firstElem.symbol == SYMBOL_LAMBDA)
             {
                 ValidateListLength(cell, 3, 3);
                 // Add check for list length
@@ -806,7 +826,7 @@ Node::Ptr Graph::Build(const Cell &cell)
                         auto newSubGraph = BuildNode<Graph>(this);
                         for(size_t i = 0; i < params.size(); i++)
                         {
-                            newSubGraph->DefineNode(params[i].details.text,
+                            newSubGraph->DefineNode(params[i].symbol,
                                     node->mParents[i]);
                         }
                         return newSubGraph->Build(exp);
@@ -814,12 +834,12 @@ Node::Ptr Graph::Build(const Cell &cell)
                 );
                 ret = pnode;
             }
-            else if(firstElem.details.text == "input")
+            else if(firstElem.symbol == SYMBOL_INPUT)
             {
                 ValidateListLength(cell, 2, 3);
                 
-                std::string token = cell.list[1].details.text;
-                std::string label = token;
+                const Cell* tokenCell = &cell.list[1];
+                std::string label = tokenCell->details.text;
                 if(cell.list.size() == 3)
                 {
                     auto inputStr = Build(cell.list[1]);
@@ -828,22 +848,23 @@ Node::Ptr Graph::Build(const Cell &cell)
                         throw GraphBuildException("input expected a string as the first argument", cell);
                     }
                     label = inputStr->mToken;
-                    token = cell.list[2].details.text;
+                    tokenCell = &cell.list[2];
                 }
 
+                const auto& token = tokenCell->details.text;
                 auto inputNode = BuildNode(KIND_BIND);
                 inputNode->mToken = token;
                 inputNode->mInputLabels.push_back(label);
                 inputNode->mIsInput = true;
                 
-                if(mVarNodes.find(token) != mVarNodes.end())
+                if(mVarNodes.find(tokenCell->symbol) != mVarNodes.end() || GetBuiltin(tokenCell->symbol))
                 {
                     throw GraphBuildException("Input \"" + token + "\" overrides previously defined token", cell);
                 }
 
-                DefineNode(token, inputNode);
+                DefineNode(tokenCell->symbol, inputNode);
             }
-            else if(firstElem.details.text == "input-list")
+            else if(firstElem.symbol == SYMBOL_INPUT_LIST)
             {
                 ValidateListLength(cell, 3);
 
@@ -852,7 +873,7 @@ Node::Ptr Graph::Build(const Cell &cell)
                 auto inputList = BuildNode(KIND_LIST);
                 inputList->mToken = inputToken;
 
-                DefineNode(inputToken, inputList);
+                DefineNode(cell.list[1].symbol, inputList);
 
                 // Add dimensions
                 std::deque<int> dims;
@@ -869,7 +890,7 @@ Node::Ptr Graph::Build(const Cell &cell)
                 LabelListRoot(inputList, inputToken, length, true);
                 inputList->mIsInput = true;
             }
-            else if(firstElem.details.text == "observe")
+            else if(firstElem.symbol == SYMBOL_OBSERVE)
             {
                 ValidateListLength(cell, 2, 3);
 
@@ -912,7 +933,7 @@ Node::Ptr Graph::Build(const Cell &cell)
                 LabelListRoot(varNode, token, GetListLength(varNode), false);
                 varNode->mIsObserver = true;
             }
-            else if(firstElem.details.text == "provide")
+            else if(firstElem.symbol == SYMBOL_PROVIDE)
             {
                 ValidateListLength(cell, 2, 2);
                 mProvidedNodes.push_back(cell.list[1]);
@@ -926,6 +947,8 @@ Node::Ptr Graph::Build(const Cell &cell)
                     node->mParents.push_back(Build(*arg));
                 }
 
+                // Building the arguments moved the current cell on
+                mCurrentDetails = cell.details;
                 auto proc = LookupProcedure(firstElem);
                 ret = proc(node);
             }
@@ -945,16 +968,44 @@ std::string NodeToDotLabel(Node::Ptr node)
         + "[label=\"" + node->Label() + "\"];";
 }
 
+// Shade goes from white for nodes that cost nothing to red for the
+// most expensive one
+std::string NodeToDotHeatLabel(Node::Ptr node, const NodeProfile& np, double heat)
+{
+    std::stringstream label;
+    label.precision(3);
+    label << std::to_string((long int)node.get())
+          << "[label=\"" << node->Label() << "\\n" << np.mEvaluations << " evals";
+    if(np.mCycles) label << "\\n" << np.mCycles << " cycles";
+    label << "\" style=filled fillcolor=\"0.000 " << std::fixed << heat << " 1.000\"];";
+    return label.str();
+}
+
 std::string Graph::GetDOTGraph() const
+{
+    return GetDOTGraph(std::vector<NodeProfile>());
+}
+
+std::string Graph::GetDOTGraph(const std::vector<NodeProfile>& profile) const
 {
     auto nodeLayout = GetLayout();
 
+    std::unordered_map<const Node*, const NodeProfile*> profiled;
+    uint64_t maxCost = 0;
+    const bool byCycles = std::any_of(profile.begin(), profile.end(),
+        [](const NodeProfile& np){return np.mCycles > 0;});
+    for(const auto& np : profile)
+    {
+        profiled[np.mNode.get()] = &np;
+        maxCost = std::max(maxCost, byCycles ? np.mCycles : np.mEvaluations);
+    }
+
     int i = 0;
     std::string ret = "{\n";
     for(auto& nodeptr : nodeLayout)
     {
         auto childLabel = NodeToPtrString(nodeptr);
-        for(auto parent : nodeptr->mParents)
+        for(const auto& parent : nodeptr->mParents)
         {
             ret += NodeToPtrString(parent) + " -> " 
                 + childLabel + "\n";
@@ -970,7 +1021,17 @@ std::string Graph::GetDOTGraph() const
             }
             ++i;
         }
-        ret += NodeToDotLabel(nodeptr) + "\n";
+
+        auto np = profiled.find(nodeptr.get());
+        if(np != profiled.end())
+        {
+            const auto cost = byCycles ? np->second->mCycles : np->second->mEvaluations;
+            ret += NodeToDotHeatLabel(nodeptr, *np->second, maxCost ? double(cost)/maxCost : 0.0) + "\n";
+        }
+        else
+        {
+            ret += NodeToDotLabel(nodeptr) + "\n";
+        }
     }
 
     ret += "}";
@@ -978,36 +1039,177 @@ std::string Graph::GetDOTGraph() const
     return ret;
 }
 
-void TraverseNodes(Node::Ptr node, uint64_t& height, std::set<Node::Ptr>& necessaryNodes)
+NodeProfile GetNodeProfile(const Node::Ptr& node)
 {
-    if (height > node->mHeight) node->mHeight = height;
-    necessaryNodes.insert(node);
-    height++;
-    for(auto parent : node->mParents)
+    NodeProfile np;
+    np.mNode = node;
+    np.mToken = node->mToken;
+    np.mLine = node->mDetails.firstLineNumber;
+    np.mColumn = node->mDetails.firstColumn;
+
+    // Observed nodes go by their observer labels, inputs
+    // by their input labels and everything else by procedure
+    const auto& labels = node->mObserverLabels.size() ? node->mObserverLabels : node->mInputLabels;
+    std::set<std::string> seen;
+    for(const auto& l : labels)
+    {
+        if(!seen.insert(l).second) continue;
+        if(!np.mLabel.empty()) np.mLabel += ",";
+        np.mLabel += l;
+    }
+    return np;
+}
+
+void SortProfile(std::vector<NodeProfile>& profile)
+{
+    std::stable_sort(profile.begin(), profile.end(), [](const NodeProfile& lhs, const NodeProfile& rhs)
+    {
+        return (lhs.mCycles > rhs.mCycles) ||
+            ((lhs.mCycles == rhs.mCycles) && (lhs.mEvaluations > rhs.mEvaluations));
+    });
+}
+
+std::string FormatProfileReport(const std::vector<NodeProfile>& profile, bool withChanges)
+{
+    std::stringstream report;
+    report << std::setw(14) << "cycles" << std::setw(10) << "evals";
+    if(withChanges) report << std::setw(10) << "changes" << std::setw(10) << "wasted";
+    report << "  " << std::setw(10) << std::left << "location"
+           << std::setw(11) << "proc" << "label\n" << std::right;
+
+    for(const auto& np : profile)
+    {
+        std::string location = "-";
+        if(np.mLine >= 0)
+        {
+            location = std::to_string(np.mLine+1) + ":" + std::to_string(np.mColumn+1);
+        }
+        report << std::setw(14) << np.mCycles << std::setw(10) << np.mEvaluations;
+        if(withChanges) report << std::setw(10) << np.mChanges << std::setw(10) << np.GetWasted();
+        report << "  " << std::setw(10) << std::left << location
+               << std::setw(11) << np.mToken << np.mLabel << "\n" << std::right;
+    }
+    return report.str();
+}
+
+// Depth first walk up the parents from the roots visiting each node
+// once. Nodes are appended after all of their parents
+void TopologicalOrder(const std::vector<Node::Ptr>& roots, std::vector<Node::Ptr>& order)
+{
+    std::unordered_set<Node*> visited;
+    // Points at the pointers held by the graph to save copying them
+    std::vector<std::pair<const Node::Ptr*, size_t>> stack;
+    for(const auto& root : roots)
+    {
+        if(!visited.insert(root.get()).second) continue;
+        stack.emplace_back(&root, 0);
+        while(stack.size())
+        {
+            auto& top = stack.back();
+            const auto& parents = (*top.first)->mParents;
+            if(top.second < parents.size())
+            {
+                const auto& parent = parents[top.second++];
+                if(visited.insert(parent.get()).second)
+                {
+                    stack.emplace_back(&parent, 0);
+                }
+            }
+            else
+            {
+                order.push_back(*top.first);
+                stack.pop_back();
+            }
+        }
+    }
+}
+
+// Height is the longest path from a node down to any of the roots so
+// every node sits above all of its children. Returns the nodes reached
+std::vector<Node::Ptr> AssignHeights(const std::vector<Node::Ptr>& roots)
+{
+    std::vector<Node::Ptr> order;
+    TopologicalOrder(roots, order);
+
+    for(auto& node : order) node->mHeight = 0;
+    // Start from one so list observer node copies can slot in beneath
+    for(auto& root : roots) root->mHeight = 1;
+
+    // Children come before parents walking backwards
+    for(auto node = order.rbegin(); node != order.rend(); ++node)
+    {
+        const auto height = (*node)->mHeight + 1;
+        for(auto& parent : (*node)->mParents)
+        {
+            parent->mHeight = std::max(parent->mHeight, height);
+        }
+    }
+    return order;
+}
+
+// Breadth first walk up the parents from the roots
+std::vector<Node::Ptr> BreadthFirstOrder(const std::vector<Node::Ptr>& roots)
+{
+    std::unordered_set<Node*> visited;
+    std::vector<Node::Ptr> order;
+    for(const auto& root : roots)
+    {
+        if(visited.insert(root.get()).second) order.push_back(root);
+    }
+    for(size_t i = 0; i < order.size(); ++i)
+    {
+        for(const auto& parent : order[i]->mParents)
+        {
+            if(visited.insert(parent.get()).second) order.push_back(parent);
+        }
+    }
+    return order;
+}
+
+// Nodes come in parents first depth first order from AssignHeights.
+// Everything here only depends on the graph so the result is the
+// same every run regardless of where nodes were allocated
+void ApplyLayoutStrategy(Graph::LayoutStrategy strategy, const std::vector<Node::Ptr>& roots,
+        std::vector<Node::Ptr>& nodes)
+{
+    auto byHeight = [](const Node::Ptr& lhs, const Node::Ptr& rhs)
+    {
+        return lhs->mHeight > rhs->mHeight;
+    };
+
+    switch(strategy)
     {
-        TraverseNodes(parent, height, necessaryNodes);
+        case Graph::LAYOUT_HEIGHT:
+            std::stable_sort(nodes.begin(), nodes.end(), byHeight);
+            break;
+        case Graph::LAYOUT_BFS:
+            nodes = BreadthFirstOrder(roots);
+            std::stable_sort(nodes.begin(), nodes.end(), byHeight);
+            break;
+        case Graph::LAYOUT_DFS:
+            break;
     }
 }
 
-void CollectListMembers(Node::Ptr node, std::vector<Node::Ptr>& nodes)
+void CollectListMembers(const Node::Ptr& node, std::vector<Node::Ptr>& nodes)
 {
     if(node->mKind != Node::KIND_LIST)
     {
         nodes.push_back(node);
         return;
     }
-    for(auto parent : node->mParents)
+    for(const auto& parent : node->mParents)
     {
         CollectListMembers(parent, nodes);
     }
 }
 
-void Graph::CollectForceKeep(Node::Ptr node, std::vector<Node::Ptr>& nodes) const
+void Graph::CollectForceKeep(const Node::Ptr& node, std::vector<Node::Ptr>& nodes) const
 {
     if(node->mKind == Node::KIND_GRAPH)
     {
         auto g = static_cast<Graph*>(node.get());
-        for(auto n : g->mAllNodes)
+        for(const auto& n : g->mAllNodes)
         {
             CollectForceKeep(n, nodes);
         }
@@ -1018,12 +1220,12 @@ void Graph::CollectForceKeep(Node::Ptr node, std::vector<Node::Ptr>& nodes) cons
     }
 }
 
-void Graph::CollectInputs(Node::Ptr node, std::vector<Node::Ptr>& inputs) const
+void Graph::CollectInputs(const Node::Ptr& node, std::vector<Node::Ptr>& inputs) const
 {
     if(node->mKind == Node::KIND_GRAPH)
     {
         auto g = static_cast<Graph*>(node.get());
-        for(auto n : g->mAllNodes)
+        for(const auto& n : g->mAllNodes)
         {
             CollectInputs(n, inputs);
         }
@@ -1034,12 +1236,12 @@ void Graph::CollectInputs(Node::Ptr node, std::vector<Node::Ptr>& inputs) const
     }
 }
 
-void Graph::CollectObservers(Node::Ptr node, std::vector<std::vector<Node::Ptr>>& observers) const
+void Graph::CollectObservers(const Node::Ptr& node, std::vector<std::vector<Node::Ptr>>& observers) const
 {
     if(node->mKind == Node::KIND_GRAPH)
     {
         auto g = static_cast<Graph*>(node.get());
-        for(auto n : g->mAllNodes)
+        for(const auto& n : g->mAllNodes)
         {
             CollectObservers(n, observers);
         }
@@ -1055,7 +1257,7 @@ void Graph::CollectObservers(Node::Ptr node, std::vector<std::vector<Node::Ptr>>
 // We try not to update any properties of the nodes
 // in this function but if we do it has to be repeatable 
 // re. offsets
-std::vector<Node::Ptr> Graph::GetLayout() const
+std::vector<Node::Ptr> Graph::GetLayout(LayoutStrategy strategy) const
 {
     std::vector<Node::Ptr> layout;
 
@@ -1063,7 +1265,7 @@ std::vector<Node::Ptr> Graph::GetLayout() const
     std::vector<std::vector<Node::Ptr>> observers;
     std::vector<Node::Ptr> forceKeep;
     std::vector<Node::Ptr> inputs;
-    for(const auto an : mAllNodes)
+    for(const auto& an : mAllNodes)
     {
         CollectInputs(an, inputs);
         CollectForceKeep(an, forceKeep);
@@ -1071,54 +1273,44 @@ std::vector<Node::Ptr> Graph::GetLayout() const
     }
     
     // Find the necessary nodes - nodes connected to an observer or forcekeep
-    std::set<Node::Ptr> necessaryNodes;
-    for(auto ob : observers)
-    {
-        for(auto node : ob)
-        {
-            // Start from one so list observer node copies can slot in beneath
-            uint64_t height=1;
-            TraverseNodes(node, height, necessaryNodes);
-        }
-    }
-    for(auto fk : forceKeep)
+    std::vector<Node::Ptr> roots;
+    for(const auto& ob : observers)
     {
-        uint64_t height=1;
-        TraverseNodes(fk, height, necessaryNodes);
+        roots.insert(roots.end(), ob.begin(), ob.end());
     }
+    roots.insert(roots.end(), forceKeep.begin(), forceKeep.end());
+    auto necessaryNodes = AssignHeights(roots);
+    ApplyLayoutStrategy(strategy, roots, necessaryNodes);
 
     // Step 1 - Add inputs to layout
+    std::unordered_set<Node*> inputSet;
     uint64_t inputOffset = 0;
-    for(auto in : inputs)
+    for(const auto& in : inputs)
     {
         in->mIsInput = true;
         in->mInputOffset = inputOffset++;
         layout.push_back(in);
+        inputSet.insert(in.get());
     }
 
-    // Step 2 - Remove inputs from necessary nodes
-    for(auto n : layout)
-    {
-        necessaryNodes.erase(n);
-    }
-    
-    // Step 3 - Add necessary nodes
-    for(auto n : necessaryNodes)
+    // Step 2 - Add necessary nodes that aren't inputs
+    for(const auto& n : necessaryNodes)
     {
-        layout.push_back(n);
+        if(!inputSet.count(n.get())) layout.push_back(n);
     }
 
     // Step 4 - Add observer offset and if list or observing input add copies
     uint64_t observerOffset = 0;
-    for(auto oi : observers)
+    for(const auto& oi : observers)
     {
-        for(auto node : oi)
+        for(const auto& node : oi)
         {
             if((oi.size() > 1) || node->mIsInput)
             {
                 auto nodeCopy = std::make_shared<Node>(Node::KIND_PROC);
                 nodeCopy->mHeight = 0;
-                nodeCopy->mToken = "copy";
+                nodeCopy->SetProcedure(SYMBOL_COPY);
+                nodeCopy->mDetails = node->mDetails;
                 nodeCopy->mIsObserver = true;
                 nodeCopy->mObserverLabels = node->mObserverLabels;
                 nodeCopy->mInputLabels = node->mInputLabels;
@@ -1136,19 +1328,338 @@ std::vector<Node::Ptr> Graph::GetLayout() const
     return layout;
 }
 
-std::vector<std::unique_ptr<Graph>> Graph::SplitOutBy(Node::Kind kind, const std::string& token)
+void Graph::CollectLayoutRoots(const Node::Ptr& node, std::vector<Node::Ptr>& roots) const
+{
+    if(node->mKind == Node::KIND_GRAPH)
+    {
+        auto g = static_cast<Graph*>(node.get());
+        for(const auto& n : g->mAllNodes)
+        {
+            CollectLayoutRoots(n, roots);
+        }
+    }
+    else if(node->mIsInput || node->mIsObserver || node->mForceKeep)
+    {
+        roots.push_back(node);
+    }
+}
+
+void Graph::ReleaseBuildState()
+{
+    std::vector<Node::Ptr> roots;
+    for(const auto& an : mAllNodes)
+    {
+        CollectLayoutRoots(an, roots);
+    }
+
+    std::vector<Node::Ptr> released;
+    released.swap(mAllNodes);
+    for(auto& var : mVarNodes)
+    {
+        if(var.second) released.push_back(std::move(var.second));
+    }
+    for(auto& module : mModules)
+    {
+        released.push_back(std::move(module.second));
+    }
+    mVarNodes.clear();
+    mModules.clear();
+    mProvidedNodes.clear();
+    mAllNodes.swap(roots);
+    ReleaseNodes(released);
+}
+
+LayoutOffsets GetLayoutOffsets(const std::vector<Node::Ptr>& layout)
+{
+    LayoutOffsets offsets;
+    offsets.reserve(layout.size());
+    for(size_t i = 0; i < layout.size(); ++i)
+    {
+        offsets.emplace(layout[i].get(), i);
+    }
+    return offsets;
+}
+
+void Graph::CollectProcs(Node::Ptr node, Symbol symbol, std::vector<Node::Ptr>& nodes) const
+{
+    if(node->mKind == Node::KIND_GRAPH)
+    {
+        auto g = static_cast<Graph*>(node.get());
+        for(const auto& n : g->mAllNodes)
+        {
+            CollectProcs(n, symbol, nodes);
+        }
+    }
+    else if((node->mKind == Node::KIND_PROC) && (node->mSymbol == symbol))
+    {
+        nodes.push_back(node);
+    }
+}
+
+// Procedures whose value only depends on their parents. Anything
+// touching state like tick, load and store has to be left alone
+static const std::set<Symbol> PURE_PROCS =
+{
+    SYMBOL_TERNARY, SYMBOL_ADD, SYMBOL_SUB, SYMBOL_DIV, SYMBOL_MUL, SYMBOL_MOD,
+    SYMBOL_LT, SYMBOL_LE, SYMBOL_GT, SYMBOL_GE, SYMBOL_EQ, SYMBOL_NE, SYMBOL_AND,
+    SYMBOL_OR, SYMBOL_MIN, SYMBOL_MAX, SYMBOL_EXP, SYMBOL_LN, SYMBOL_TRUNC, SYMBOL_NOT
+};
+
+// Folding the two argument operators in either order gives the same
+// result so their parents can be sorted before looking for a match.
+// Min and max aren't. The interpreter's return the first argument
+// when either is NaN
+static const std::set<Symbol> COMMUTATIVE_PROCS =
+{
+    SYMBOL_ADD, SYMBOL_MUL, SYMBOL_EQ, SYMBOL_NE, SYMBOL_AND, SYMBOL_OR
+};
+
+// Nodes users can see or that have side effects must stay put
+bool HasIdentity(const Node::Ptr& node)
+{
+    return node->mIsObserver || node->mIsInput || node->mForceKeep ||
+        node->mObserverLabels.size() || node->mInputLabels.size();
+}
+
+bool IsPureProc(const Node::Ptr& node)
+{
+    return (node->mKind == Node::KIND_PROC) && PURE_PROCS.count(node->mSymbol);
+}
+
+bool IsConstValue(const Node::Ptr& node, double val)
+{
+    return (node->mKind == Node::KIND_CONST) && (std::stod(node->mToken) == val);
+}
+
+std::string ConstToken(double val)
+{
+    // Enough digits for stod to give back exactly the same double
+    std::stringstream token;
+    token.precision(std::numeric_limits<double>::max_digits10);
+    token << val;
+    return token.str();
+}
+
+template<typename Op>
+double FoldLoop(const std::vector<double>& args, Op o)
+{
+    double val = args[0];
+    for(size_t i = 1; i < args.size(); ++i)
+    {
+        val = o(val, args[i]);
+    }
+    return val;
+}
+
+// Same operations as the interpreter so folded values match
+// what would have been computed at runtime
+bool FoldProc(Symbol symbol, const std::vector<double>& args, double& val)
+{
+    switch(symbol)
+    {
+        case SYMBOL_ADD:   val = FoldLoop(args, std::plus<double>()); break;
+        case SYMBOL_SUB:   val = FoldLoop(args, std::minus<double>()); break;
+        case SYMBOL_MUL:   val = FoldLoop(args, std::multiplies<double>()); break;
+        case SYMBOL_DIV:   val = FoldLoop(args, std::divides<double>()); break;
+        case SYMBOL_MOD:   val = FoldLoop(args, [](double x, double y){return std::fmod(x, y);}); break;
+        case SYMBOL_LT:    val = args[0] < args[1]; break;
+        case SYMBOL_LE:    val = args[0] <= args[1]; break;
+        case SYMBOL_GT:    val = args[0] > args[1]; break;
+        case SYMBOL_GE:    val = args[0] >= args[1]; break;
+        case SYMBOL_EQ:    val = args[0] == args[1]; break;
+        case SYMBOL_NE:    val = args[0] != args[1]; break;
+        case SYMBOL_AND:   val = FoldLoop(args, std::logical_and<double>()); break;
+        case SYMBOL_OR:    val = FoldLoop(args, std::logical_or<double>()); break;
+        case SYMBOL_MIN:   val = FoldLoop(args, [](double x, double y){return std::min(x, y);}); break;
+        case SYMBOL_MAX:   val = FoldLoop(args, [](double x, double y){return std::max(x, y);}); break;
+        case SYMBOL_EXP:   val = std::exp(args[0]); break;
+        case SYMBOL_LN:    val = std::log(args[0]); break;
+        case SYMBOL_TRUNC: val = std::trunc(args[0]); break;
+        case SYMBOL_NOT:   val = !args[0]; break;
+        default: return false;
+    }
+    return true;
+}
+
+// Folds the procedure in place when all of its parents are constant
+// and drops operands that don't change the result e.g. (+ x 0) or
+// (* x 1). Returns the node to use instead if it can be skipped
+Node::Ptr SimplifyProc(Node::Ptr node)
+{
+    auto& parents = node->mParents;
+    const auto isConst = [](const Node::Ptr& p){return p->mKind == Node::KIND_CONST;};
+    if(std::all_of(parents.begin(), parents.end(), isConst))
+    {
+        std::vector<double> args;
+        for(const auto& p : parents)
+        {
+            args.push_back(std::stod(p->mToken));
+        }
+
+        // Backends don't agree on how NaN flows through min, max and
+        // friends so leave those to be worked out at runtime
+        double val;
+        if(std::none_of(args.begin(), args.end(), [](double a){return std::isnan(a);}) &&
+            FoldProc(node->mSymbol, args, val) && !std::isnan(val))
+        {
+            node->mKind = Node::KIND_CONST;
+            node->mSymbol = NO_SYMBOL;
+            node->mToken = ConstToken(val);
+            parents.clear();
+        }
+        return nullptr;
+    }
+
+    if(node->mSymbol == SYMBOL_TERNARY)
+    {
+        if(isConst(parents[0]) && !std::isnan(std::stod(parents[0]->mToken)))
+        {
+            return std::stod(parents[0]->mToken) ? parents[1] : parents[2];
+        }
+        return (parents[1] == parents[2]) ? parents[1] : nullptr;
+    }
+
+    double identity = 0.0;
+    size_t first = 0;
+    switch(node->mSymbol)
+    {
+        case SYMBOL_ADD: identity = 0.0; first = 0; break;
+        case SYMBOL_SUB: identity = 0.0; first = 1; break;
+        case SYMBOL_MUL: identity = 1.0; first = 0; break;
+        case SYMBOL_DIV: identity = 1.0; first = 1; break;
+        default: return nullptr;
+    }
+
+    std::vector<Node::Ptr> kept;
+    for(size_t i = 0; i < parents.size(); ++i)
+    {
+        if((i < first) || !IsConstValue(parents[i], identity))
+        {
+            kept.push_back(parents[i]);
+        }
+    }
+
+    if(kept.size() == 1)
+    {
+        return kept[0];
+    }
+    parents = kept;
+    return nullptr;
+}
+
+// Works from the parents down so by the time a node is visited its
+// parents are in their final form and anything matching it has
+// already been seen. Nodes are only changed in place or bypassed so
+// labels, offsets and anything else hanging off a node are untouched
+void Graph::Optimise()
+{
+    std::vector<std::vector<Node::Ptr>> observers;
+    std::vector<Node::Ptr> roots;
+    std::vector<Node::Ptr> simApplys;
+    for(const auto& an : mAllNodes)
+    {
+        CollectForceKeep(an, roots);
+        CollectObservers(an, observers);
+        CollectProcs(an, SYMBOL_SIM_APPLY, simApplys);
+    }
+    for(const auto& ob : observers)
+    {
+        roots.insert(roots.end(), ob.begin(), ob.end());
+    }
+    roots.insert(roots.end(), simApplys.begin(), simApplys.end());
+
+    // The sim apply layout rewrites the arguments so they can't be shared
+    std::unordered_set<Node*> pinned;
+    for(const auto& sa : simApplys)
+    {
+        for(const auto& p : sa->mParents)
+        {
+            pinned.insert(p.get());
+        }
+    }
+
+    std::vector<Node::Ptr> order;
+    TopologicalOrder(roots, order);
+
+    typedef std::pair<std::string, std::vector<Node*>> NodeKey;
+    std::map<NodeKey, Node::Ptr> shared;
+    std::unordered_map<Node*, Node::Ptr> replaced;
+    for(const auto& node : order)
+    {
+        if((node->mKind == Node::KIND_PROC) && (node->mSymbol == SYMBOL_SIM_APPLY))
+        {
+            continue;
+        }
+
+        for(auto& parent : node->mParents)
+        {
+            auto r = replaced.find(parent.get());
+            if(r != replaced.end()) parent = r->second;
+        }
+
+        if(pinned.count(node.get())) continue;
+        const bool replaceable = !HasIdentity(node);
+
+        if(IsPureProc(node))
+        {
+            auto simpler = SimplifyProc(node);
+            if(simpler && replaceable)
+            {
+                replaced[node.get()] = simpler;
+                continue;
+            }
+            else if(simpler && (simpler->mKind == Node::KIND_CONST))
+            {
+                node->mKind = Node::KIND_CONST;
+                node->mSymbol = NO_SYMBOL;
+                node->mToken = simpler->mToken;
+                node->mParents.clear();
+            }
+        }
+
+        NodeKey key;
+        if(node->mKind == Node::KIND_CONST)
+        {
+            key.first = "const " + ConstToken(std::stod(node->mToken));
+        }
+        else if(IsPureProc(node))
+        {
+            key.first = node->mToken;
+            for(const auto& p : node->mParents)
+            {
+                key.second.push_back(p.get());
+            }
+            if((key.second.size() == 2) && COMMUTATIVE_PROCS.count(node->mSymbol))
+            {
+                std::sort(key.second.begin(), key.second.end());
+            }
+        }
+        else
+        {
+            continue;
+        }
+
+        auto match = shared.emplace(key, node);
+        if(!match.second && replaceable)
+        {
+            replaced[node.get()] = match.first->second;
+        }
+    }
+}
+
+std::vector<std::unique_ptr<Graph>> Graph::SplitOutBy(Node::Kind kind, Symbol symbol)
 {
     std::vector<std::unique_ptr<Graph>> graphs;
 
     std::vector<Node::Ptr> inputs;
-    for(auto an : mAllNodes)
+    for(const auto& an : mAllNodes)
     {
         CollectInputs(an, inputs);
     }
 
-    for(auto n : mAllNodes)
+    for(const auto& n : mAllNodes)
     {
-        if((n->mKind == Node::KIND_PROC) && (n->mToken.compare(token) == 0))
+        if((n->mKind == Node::KIND_PROC) && (n->mSymbol == symbol))
         {
             std::vector<Node::Ptr> graphNodes;
             graphNodes.insert(graphNodes.end(), inputs.begin(), inputs.end());
@@ -1168,21 +1679,21 @@ std::vector<std::unique_ptr<Graph>> Graph::SplitOutBy(Node::Kind kind, const std
 // 3. Alot of information used about param layout is implicitly contained
 // in the GetLayout function which is fine when its abstracted away from users
 // but we are trying to abuse that here
-std::vector<Node::Ptr> Graph::GetSimApplyLayout() const
+std::vector<Node::Ptr> Graph::GetSimApplyLayout(LayoutStrategy strategy) const
 { 
     // Flatten collected nodes into continous block
     // Step 1 - Add inputs
-    auto nodeLayout = GetLayout();
+    auto nodeLayout = GetLayout(strategy);
     int64_t maxOffset = 0;
-    for(auto an : nodeLayout)
+    for(const auto& an : nodeLayout)
     {
         maxOffset = std::max(an->mInputOffset, maxOffset);
     }
 
     std::vector<Node::Ptr> simnodes;
-    for(auto n : mAllNodes)
+    for(const auto& n : mAllNodes)
     {
-        if((n->mKind == Node::KIND_PROC) && (n->mToken.compare("sim-apply") == 0))
+        if((n->mKind == Node::KIND_PROC) && (n->mSymbol == SYMBOL_SIM_APPLY))
         {
             simnodes.push_back(n);
         }
@@ -1222,7 +1733,7 @@ std::vector<Node::Ptr> Graph::GetSimApplyLayout() const
                 auto simapply = std::make_shared<Node>(Node::KIND_PROC);
                 simapply->mIsObserver = true;
                 simapply->mHeight = 0;
-                simapply->mToken = "sim-apply";
+                simapply->SetProcedure(SYMBOL_SIM_APPLY);
                 simapply->mObserverLabels = simListNodes[i]->mInputLabels;
                 simapply->mObserverOffset = simListNodes[i]->mInputOffset;
                 simapply->mLength = 1;
@@ -1234,7 +1745,7 @@ std::vector<Node::Ptr> Graph::GetSimApplyLayout() const
         {
             n->mIsObserver = true;
             n->mHeight = 0;
-            n->mToken = "sim-apply";
+            n->SetProcedure(SYMBOL_SIM_APPLY);
             n->mObserverLabels = target->mInputLabels;
             n->mObserverOffset = target->mInputOffset;
             n->mLength = 1;
@@ -1245,19 +1756,8 @@ std::vector<Node::Ptr> Graph::GetSimApplyLayout() const
     }
 
     // Collect necessary nodes and set heights
-    std::set<Node::Ptr> necessarySimNodes;
-    for(auto n : expandedSimApply)
-    {
-        uint64_t height=1;
-        TraverseNodes(n, height, necessarySimNodes); 
-    }
-    
-    // Build layout
-    std::vector<Node::Ptr> layout;
-    for(auto n : necessarySimNodes)
-    {
-        layout.push_back(n);
-    }
+    auto layout = AssignHeights(expandedSimApply);
+    ApplyLayoutStrategy(strategy, expandedSimApply, layout);
 
     return layout;
 }
@@ -1265,9 +1765,9 @@ std::vector<Node::Ptr> Graph::GetSimApplyLayout() const
 std::string Graph::GetSimApplyTarget() const
 {
     std::vector<Node::Ptr> simnodes;
-    for(auto n : mAllNodes)
+    for(const auto& n : mAllNodes)
     {
-        if((n->mKind == Node::KIND_PROC) && (n->mToken.compare("sim-apply") == 0))
+        if((n->mKind == Node::KIND_PROC) && (n->mSymbol == SYMBOL_SIM_APPLY))
         {
             simnodes.push_back(n);
         }
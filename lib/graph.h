@@ -12,6 +12,7 @@
 #include <unordered_map>
 
 #include "parser.h"
+#include "symbol.h"
 
 namespace Exys
 {
@@ -42,9 +43,17 @@ public:
         return mToken;
     }
 
+    void SetProcedure(Symbol symbol)
+    {
+        mSymbol = symbol;
+        mToken = SymbolTable::Get().GetName(symbol);
+    }
+
     Kind mKind=KIND_UNKNOWN;
 
     std::string mToken = "";
+    // Interned token of procedures so backends can dispatch on it
+    Symbol mSymbol = NO_SYMBOL;
     std::vector<Ptr> mParents;
     std::vector<std::string> mInputLabels;
     std::vector<std::string> mObserverLabels;
@@ -52,6 +61,9 @@ public:
     bool mIsObserver = false;
     bool mIsInput = false;
     bool mForceKeep = false;
+
+    // Where in the source the node was built
+    TokenDetails mDetails = {"", -1, -1, -1, -1};
     
     // For use in later stages
     uint64_t mHeight = 0;
@@ -105,40 +117,68 @@ struct Procedure
     ProcedureValidationFunction validate;
 };
 
+struct NodeProfile;
+
 class Graph : public Node
 {
 public:
     Graph(Graph* parent=nullptr);
+    ~Graph();
 
     void Construct(const Cell& cell);
     void SetSupportedProcedures(const std::vector<Procedure>& procs);
 
+    // Folds constant subtrees, simplifies identities like (+ x 0) and
+    // shares structurally identical nodes. Run after Construct
+    void Optimise();
+
+    // Order of the computed nodes in a layout. Inputs always come first
+    enum LayoutStrategy
+    {
+        LAYOUT_HEIGHT, // Tallest first, each height in depth first order
+        LAYOUT_BFS,    // Tallest first, each height in breadth first order
+        LAYOUT_DFS     // Depth first so nodes sit just after their parents
+    };
+
     std::string GetDOTGraph() const;
-    std::vector<Node::Ptr> GetLayout() const;
-    std::vector<Node::Ptr> GetSimApplyLayout() const;
+    // Nodes are shaded by the share of cycles, or evaluations
+    // if no cycles were counted, they took in the profile
+    std::string GetDOTGraph(const std::vector<NodeProfile>& profile) const;
+    std::vector<Node::Ptr> GetLayout(LayoutStrategy strategy=LAYOUT_HEIGHT) const;
+    std::vector<Node::Ptr> GetSimApplyLayout(LayoutStrategy strategy=LAYOUT_HEIGHT) const;
 
     std::string GetSimApplyTarget() const;
 
-    std::vector<std::unique_ptr<Graph>> SplitOutBy(Node::Kind kind, const std::string& token);
+    std::vector<std::unique_ptr<Graph>> SplitOutBy(Node::Kind kind, Symbol symbol);
+
+    // Frees scopes, procedure factories, required files and every node
+    // no layout starts from once an engine has been built from the
+    // graph. Layouts taken afterwards come out the same
+    void ReleaseBuildState();
 
 private:
     Graph(std::vector<Node::Ptr> nodes);
 
-    void DefineNode(const std::string& token, const Cell& cell);
-    void DefineNode(const std::string& token, Node::Ptr node);
+    void DefineNode(Symbol symbol, const Cell& cell);
+    void DefineNode(Symbol symbol, Node::Ptr node);
 
     Node::Ptr Build(const Cell& cell);
     ProcNodeFactoryFunc DefaultFactory(const Procedure& procedure);
     void AddProcFactory(const std::string id, ProcNodeFactoryFunc factory);
+    typedef Node::Ptr (Graph::*BuiltinFunc)(Node::Ptr);
+    static BuiltinFunc GetBuiltin(Symbol symbol);
+    Node::Ptr BuildBuiltin(Symbol symbol);
     Node::Ptr LookupSymbol(const Cell& cell);
     ProcNodeFactoryFunc LookupProcedure(const Cell& cell);
     void SetSymbol(const Cell& cell, Node::Ptr node);
     Node::Ptr BuildForProcedure(const Cell& token);
     void BuildInputList(Node::Ptr child, const std::string& token, std::deque<int> dims);
     void LabelListRoot(Node::Ptr node, std::string label, uint16_t length, bool inputLabel);
-    void CollectInputs(Node::Ptr node, std::vector<Node::Ptr>& inputs) const;
-    void CollectObservers(Node::Ptr node, std::vector<std::vector<Node::Ptr>>& observers) const;
-    void CollectForceKeep(Node::Ptr node, std::vector<Node::Ptr>& nodes) const;
+    void CollectInputs(const Node::Ptr& node, std::vector<Node::Ptr>& inputs) const;
+    void CollectObservers(const Node::Ptr& node, std::vector<std::vector<Node::Ptr>>& observers) const;
+    void CollectForceKeep(const Node::Ptr& node, std::vector<Node::Ptr>& nodes) const;
+    void CollectProcs(Node::Ptr node, Symbol symbol, std::vector<Node::Ptr>& nodes) const;
+    void CollectLayoutRoots(const Node::Ptr& node, std::vector<Node::Ptr>& roots) const;
     
     // Graph manipulation functions
     Node::Ptr Map(Node::Ptr node);
@@ -161,14 +201,50 @@ private:
     std::shared_ptr<T> BuildNode(Args... as);
 
     std::vector<Node::Ptr> mAllNodes;
-    std::unordered_map<std::string, Node::Ptr> mVarNodes;
+    std::unordered_map<Symbol, Node::Ptr> mVarNodes;
     std::vector<Cell> mProvidedNodes;
+    // Required files already built, only kept on the root graph
+    std::unordered_map<std::string, std::shared_ptr<Graph>> mModules;
 
     Graph* mParent;
-    Cell mCurrentCell;
+    // Only the details so building doesn't copy every subtree
+    TokenDetails mCurrentDetails = {"", -1, -1, -1, -1};
 };
 
 
+// Evaluations of a node and cycles spent in it while profiling. Wasted
+// evaluations computed the value the node already had. Backends that
+// can't tell if a value changed leave mChanges at zero
+struct NodeProfile
+{
+    Node::Ptr mNode;
+    std::string mLabel;
+    std::string mToken;
+    int mLine = -1;
+    int mColumn = -1;
+    uint64_t mEvaluations = 0;
+    uint64_t mChanges = 0;
+    uint64_t mCycles = 0;
+
+    uint64_t GetWasted() const
+    {
+        return mEvaluations - mChanges;
+    }
+};
+
+// Label, procedure and source location of the node with no counts
+NodeProfile GetNodeProfile(const Node::Ptr& node);
+
+// Most cycles first then most evaluations
+void SortProfile(std::vector<NodeProfile>& profile);
+std::string FormatProfileReport(const std::vector<NodeProfile>& profile, bool withChanges=true);
+
+typedef std::unordered_map<const Node*, size_t> LayoutOffsets;
+
+// Position of each node in a layout so backends can wire up
+// parents without searching the layout for every edge
+LayoutOffsets GetLayoutOffsets(const std::vector<Node::Ptr>& layout);
+
 class GraphBuildException : public std::exception
 {
 public:
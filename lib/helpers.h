@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cmath>
 #include <string>
 #include <sstream>
 #include "graph.h"
@@ -19,6 +20,37 @@ inline std::string GetLine(const std::string& text, int line)
     return text.substr(prev, pos == std::string::npos ? std::string::npos : pos - prev);
 }
 
+// Refills values with the label and value of each point. Labels are
+// only copied when they change so a vector that has been filled
+// before is refilled without allocating
+template<typename Points, typename GetValue>
+void FillPointValues(const Points& points, GetValue getValue, std::vector<std::pair<std::string, double>>& values)
+{
+    values.resize(points.size());
+    auto value = values.begin();
+    for(const auto& ip : points)
+    {
+        if(value->first != ip.first) value->first = ip.first;
+        value->second = getValue(ip.second);
+        ++value;
+    }
+}
+
+// Position of each processor by the symbol of its procedure so nodes
+// are dispatched with one lookup. -1 for symbols without a processor
+template<typename Processor>
+std::vector<int> IndexBySymbol(const std::vector<Processor>& processors)
+{
+    std::vector<int> index(NUM_FIXED_SYMBOLS, -1);
+    for(size_t i = 0; i < processors.size(); ++i)
+    {
+        const auto symbol = SymbolTable::Get().Intern(processors[i].procedure.id);
+        if(symbol >= index.size()) index.resize(symbol + 1, -1);
+        index[symbol] = i;
+    }
+    return index;
+}
+
 inline void DummyValidator(Node::Ptr)
 {
 }
@@ -92,6 +124,33 @@ inline void CountValueValidator(Node::Ptr point)
     CheckKindForPrimitive(point);
 }
 
+// Largest window a rolling procedure may keep. Each window holds
+// its values and, for min and max, a queue of the same length
+const uint32_t MAX_WINDOW_SIZE = 1 << 20;
+
+// Rolling procedures take a window size, a gate and a value. The size
+// decides how much state they get so it has to be known when building
+inline void RollingValidator(Node::Ptr point)
+{
+    CountValueValidator<3,3>(point);
+    const auto& size = point->mParents[0];
+    const double length = (size->mKind == Node::KIND_CONST) ? std::stod(size->mToken) : 0.0;
+    if(!(length >= 1) || (length != std::trunc(length)) || (length > MAX_WINDOW_SIZE))
+    {
+        Cell cell;
+        std::stringstream err;
+        err << "Window size must be a constant whole number from 1 to "
+            << MAX_WINDOW_SIZE << ". Got " << size->mToken;
+        throw GraphBuildException(err.str(), cell);
+    }
+}
+
+// Only called on nodes RollingValidator passed
+inline uint32_t GetWindowSize(const Node::Ptr& node)
+{
+    return static_cast<uint32_t>(std::stod(node->mParents[0]->mToken));
+}
+
 inline void ValidateArgsNotNull(Node::Ptr point)
 {
     int i = 0;
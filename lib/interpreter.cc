@@ -4,6 +4,11 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "interpreter.h"
 #include "helpers.h"
@@ -23,50 +28,13 @@
 namespace Exys
 {
 
-void ConstDummy(InterPoint& /*point*/)
-{
-}
-
-void Copy(InterPoint& ipoint)
-{
-    assert(ipoint.mParents.size() == 1);
-    *ipoint.mPoint = *ipoint.mParents[0]->mPoint;
-}
-
-void Load(InterPoint& ipoint)
-{
-    assert(ipoint.mParents.size() == 1);
-    *ipoint.mPoint = *ipoint.mParents[0]->mPoint;
-}
-
-void Interpreter::Store(InterPoint& ipoint)
+inline uint64_t ReadCycleCounter()
 {
-    assert(ipoint.mParents.size() == 2);
-    *ipoint.mParents[0]->mPoint = *ipoint.mParents[1]->mPoint;
-    *ipoint.mPoint = *ipoint.mParents[1]->mPoint;
-    mDirtyStores.push_back(ipoint.mParents[0]);
-}
-
-ComputeFunction Tick()
-{
-    uint64_t tick=0;
-    return [tick](InterPoint& ipoint) mutable
-    {
-        *ipoint.mPoint = ++tick;
-    };
-}
-
-void Ternary(InterPoint& ipoint)
-{
-    assert(ipoint.mParents.size() == 3);
-    if(ipoint.mParents[0]->mPoint->mVal)
-    {
-        *ipoint.mPoint = *ipoint.mParents[1]->mPoint;
-    }
-    else
-    {
-        *ipoint.mPoint = *ipoint.mParents[2]->mPoint;
-    }
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
 }
 
 #define FUNCTOR(_NAME, _T, _FUNC) \
@@ -95,82 +63,153 @@ FUNCTOR(LogFunc, double, std::log);
 FUNCTOR(TruncFunc, double, std::trunc);
 
 template<typename Op> 
-void LoopOperator(InterPoint& ipoint)
+inline void LoopOperator(Point& point, const Point* points, const uint32_t* p, const uint32_t* end)
 {
-    assert(ipoint.mParents.size() >= 2);
+    assert(end - p >= 2);
     Op o;
-    auto p = ipoint.mParents.begin();
-    auto& point = *ipoint.mPoint;
-    point = *(*p)->mPoint;
-    for(p++; p != ipoint.mParents.end(); p++)
+    point = points[*p];
+    for(p++; p != end; p++)
     {
-        point = o(point.mVal, (*p)->mPoint->mVal);
+        point = o(point.mVal, points[*p].mVal);
     }
 }
 
 template<typename Op> 
-void UnaryOperator(InterPoint& ipoint)
+inline void UnaryOperator(Point& point, const Point* points, const uint32_t* p, const uint32_t* end)
 {
-    assert(ipoint.mParents.size() == 1);
+    assert(end - p == 1);
     Op o;
-    *ipoint.mPoint = o(ipoint.mParents[0]->mPoint->mVal);
+    point = o(points[p[0]].mVal);
 }
 
 template<typename Op> 
-void PairOperator(InterPoint& ipoint)
+inline void PairOperator(Point& point, const Point* points, const uint32_t* p, const uint32_t* end)
 {
-    assert(ipoint.mParents.size() == 2);
+    assert(end - p == 2);
     Op o;
-    *ipoint.mPoint = o(ipoint.mParents[0]->mPoint->mVal, ipoint.mParents[1]->mPoint->mVal);
+    point = o(points[p[0]].mVal, points[p[1]].mVal);
 }
 
-void Null(InterPoint&)
+inline void Ternary(Point& point, const Point* points, const uint32_t* p, const uint32_t* end)
 {
+    assert(end - p == 3);
+    point = points[p[0]].mVal ? points[p[1]] : points[p[2]];
 }
 
-std::function<ComputeFunction ()> Wrap(ComputeFunction func)
+inline void Copy(Point& point, const Point* points, const uint32_t* p, const uint32_t* end)
 {
-    return [func]() -> ComputeFunction {return func;};
+    assert(end - p == 1);
+    point = points[p[0]];
 }
 
-#define WRAP(__FUNC) \
-    [this]() -> ComputeFunction {return [this](InterPoint& ipoint) {this->__FUNC(ipoint);};} \
-
 static InterPointProcessor AVAILABLE_PROCS[] =
 {
-    {{"?",          CountValueValidator<3,3>},   Wrap(Ternary)},
-    {{"+",          MinCountValueValidator<2>},  Wrap(LoopOperator<std::plus<double>>)},
-    {{"-",          MinCountValueValidator<2>},  Wrap(LoopOperator<std::minus<double>>)},
-    {{"/",          MinCountValueValidator<2>},  Wrap(LoopOperator<std::divides<double>>)},
-    {{"*",          MinCountValueValidator<2>},  Wrap(LoopOperator<std::multiplies<double>>)},
-    {{"%",          MinCountValueValidator<2>},  Wrap(LoopOperator<ModFunc>)},
-    {{"<",          CountValueValidator<2,2>},   Wrap(PairOperator<std::less<double>>)},
-    {{"<=",         CountValueValidator<2,2>},   Wrap(PairOperator<std::less_equal<double>>)},
-    {{">",          CountValueValidator<2,2>},   Wrap(PairOperator<std::greater<double>>)},
-    {{">=",         CountValueValidator<2,2>},   Wrap(PairOperator<std::greater_equal<double>>)},
-    {{"==",         CountValueValidator<2,2>},   Wrap(PairOperator<std::equal_to<double>>)},
-    {{"!=",         CountValueValidator<2,2>},   Wrap(PairOperator<std::not_equal_to<double>>)},
-    {{"&&",         MinCountValueValidator<2>},  Wrap(LoopOperator<std::logical_and<double>>)},
-    {{"||",         MinCountValueValidator<2>},  Wrap(LoopOperator<std::logical_or<double>>)},
-    {{"min",        MinCountValueValidator<2>},  Wrap(LoopOperator<MinFunc>)},
-    {{"max",        MinCountValueValidator<2>},  Wrap(LoopOperator<MaxFunc>)},
-    {{"exp",        CountValueValidator<1,1>},   Wrap(UnaryOperator<ExpFunc>)},
-    {{"ln",         CountValueValidator<1,1>},   Wrap(UnaryOperator<LogFunc>)},
-    {{"trunc",      CountValueValidator<1,1>},   Wrap(UnaryOperator<TruncFunc>)},
-    {{"not",        CountValueValidator<1,1>},   Wrap(UnaryOperator<std::logical_not<double>>)},
-    {{"tick",       MinCountValueValidator<0>},  Tick},
-    {{"copy",       MinCountValueValidator<1>},  Wrap(Copy)},
-    {{"load",       CountValueValidator<1,1>},   Wrap(Copy)},
-    {{"sim-apply",  DummyValidator},  Wrap(Null)}
+    {{"?",          CountValueValidator<3,3>},   OP_TERNARY},
+    {{"+",          MinCountValueValidator<2>},  OP_ADD},
+    {{"-",          MinCountValueValidator<2>},  OP_SUB},
+    {{"/",          MinCountValueValidator<2>},  OP_DIV},
+    {{"*",          MinCountValueValidator<2>},  OP_MUL},
+    {{"%",          MinCountValueValidator<2>},  OP_MOD},
+    {{"<",          CountValueValidator<2,2>},   OP_LT},
+    {{"<=",         CountValueValidator<2,2>},   OP_LE},
+    {{">",          CountValueValidator<2,2>},   OP_GT},
+    {{">=",         CountValueValidator<2,2>},   OP_GE},
+    {{"==",         CountValueValidator<2,2>},   OP_EQ},
+    {{"!=",         CountValueValidator<2,2>},   OP_NE},
+    {{"&&",         MinCountValueValidator<2>},  OP_AND},
+    {{"||",         MinCountValueValidator<2>},  OP_OR},
+    {{"min",        MinCountValueValidator<2>},  OP_MIN},
+    {{"max",        MinCountValueValidator<2>},  OP_MAX},
+    {{"exp",        CountValueValidator<1,1>},   OP_EXP},
+    {{"ln",         CountValueValidator<1,1>},   OP_LN},
+    {{"trunc",      CountValueValidator<1,1>},   OP_TRUNC},
+    {{"not",        CountValueValidator<1,1>},   OP_NOT},
+    {{"tick",       MinCountValueValidator<0>},  OP_TICK},
+    {{"copy",       MinCountValueValidator<1>},  OP_COPY},
+    {{"load",       CountValueValidator<1,1>},   OP_COPY},
+    {{"store",      CountValueValidator<2,2>},   OP_STORE},
+    {{"sim-apply",  DummyValidator},             OP_NONE},
+    {{"rolling-sum",  RollingValidator},         OP_ROLLING_SUM},
+    {{"rolling-mean", RollingValidator},         OP_ROLLING_MEAN},
+    {{"rolling-min",  RollingValidator},         OP_ROLLING_MIN},
+    {{"rolling-max",  RollingValidator},         OP_ROLLING_MAX}
 };
 
+RollingWindow::RollingWindow(OpCode op, uint32_t size)
+: mOp(op)
+, mValues(size)
+{
+    if(op == OP_ROLLING_MIN || op == OP_ROLLING_MAX) mQueue.resize(size);
+}
+
+// The jitter generates the same steps so both give identical results
+void RollingWindow::Push(double val)
+{
+    const uint32_t size = mValues.size();
+    const bool full = mCount == size;
+    if(mOp == OP_ROLLING_SUM || mOp == OP_ROLLING_MEAN)
+    {
+        if(full) mSum -= mValues[mHead];
+        else ++mCount;
+        mValues[mHead] = val;
+        mSum += val;
+        if(++mHead == size)
+        {
+            // Start again from the values once a lap so rounding
+            // errors and infinities don't stick around
+            mHead = 0;
+            mSum = 0.0;
+            for(auto v : mValues) mSum += v;
+        }
+        return;
+    }
+
+    // The oldest value is about to be overwritten
+    if(full && mQueueSize && mQueue[mQueueHead] == mHead)
+    {
+        if(++mQueueHead == size) mQueueHead = 0;
+        --mQueueSize;
+    }
+    if(!full) ++mCount;
+    mValues[mHead] = val;
+
+    // Older values that can't beat the new one never will again
+    const bool max = mOp == OP_ROLLING_MAX;
+    while(mQueueSize)
+    {
+        auto back = mQueueHead + mQueueSize - 1;
+        if(back >= size) back -= size;
+        const auto old = mValues[mQueue[back]];
+        if(max ? !(old <= val) : !(old >= val)) break;
+        --mQueueSize;
+    }
+    auto tail = mQueueHead + mQueueSize;
+    if(tail >= size) tail -= size;
+    mQueue[tail] = mHead;
+    ++mQueueSize;
+
+    if(++mHead == size) mHead = 0;
+}
+
+// Empty until the first push
+double RollingWindow::Get() const
+{
+    if(!mCount) return 0.0;
+    switch(mOp)
+    {
+        case OP_ROLLING_SUM:  return mSum;
+        case OP_ROLLING_MEAN: return mSum / mCount;
+        default:              return mValues[mQueue[mQueueHead]];
+    }
+}
+
 Interpreter::Interpreter()
 { 
     for(auto& jpp : AVAILABLE_PROCS)
     {
         mPointProcessors.push_back(jpp);
     }
-    mPointProcessors.push_back({{"store",      CountValueValidator<2,2>},   WRAP(Store)});
+    mProcessorIndex = IndexBySymbol(mPointProcessors);
 }
 
 std::string Interpreter::GetDOTGraph() const
@@ -178,7 +217,7 @@ std::string Interpreter::GetDOTGraph() const
     return "digraph " + mGraph->GetDOTGraph();
 }
 
-ComputeFunction Interpreter::LookupComputeFunction(Node::Ptr node)
+OpCode Interpreter::LookupOpCode(Node::Ptr node)
 {
     switch(node->mKind)
     {
@@ -186,200 +225,317 @@ ComputeFunction Interpreter::LookupComputeFunction(Node::Ptr node)
         case Node::KIND_BIND:
         case Node::KIND_VAR:
         case Node::KIND_LIST:
-            return ConstDummy;
+            return OP_NONE;
         default:
         {
-            for(auto& proc : mPointProcessors)
+            if(node->mSymbol < mProcessorIndex.size() && mProcessorIndex[node->mSymbol] >= 0)
             {
-                if(node->mToken.compare(proc.procedure.id) == 0)
-                {
-                    return proc.func();
-                }
+                return mPointProcessors[mProcessorIndex[node->mSymbol]].op;
             }
         }
     }
     assert(false);
-    return nullptr;
+    return OP_NONE;
 }
 
-static size_t FindNodeOffset(const std::vector<Node::Ptr>& nodes, Node::Ptr node)
+static size_t FindNodeOffset(const LayoutOffsets& offsets, const Node::Ptr& node)
 {
-    auto niter = std::find(std::begin(nodes), std::end(nodes), node);
-    assert(niter != nodes.end());
-    return std::distance(nodes.begin(), niter);
+    auto niter = offsets.find(node.get());
+    assert(niter != offsets.end());
+    return niter->second;
 }
 
 void Interpreter::CompleteBuild()
 {
-    const auto nodeLayout = mGraph->GetLayout();
+    // Recompute walks the buckets tallest first so lay points out the same way
+    mNodeLayout = mGraph->GetLayout(Graph::LAYOUT_HEIGHT);
+    const auto& nodeLayout = mNodeLayout;
+    const auto layoutOffsets = GetLayoutOffsets(nodeLayout);
 
     // For cache niceness
     mInterPointGraph.resize(nodeLayout.size());
     mPoints.resize(nodeLayout.size());
+    mBatchStamps.resize(nodeLayout.size());
 
     // Finish adding bulk of logic
-    for(const auto& node : nodeLayout)
+    std::vector<int64_t> heights(nodeLayout.size());
+    std::vector<std::vector<uint32_t>> children(nodeLayout.size());
+    size_t numStores = 0;
+    for(size_t offset = 0; offset < nodeLayout.size(); ++offset)
     {
-        size_t offset = FindNodeOffset(nodeLayout, node);
-        auto& point = mInterPointGraph[offset];
+        const auto& node = nodeLayout[offset];
+        auto& ipoint = mInterPointGraph[offset];
+        auto& point = mPoints[offset];
 
-        point.mHeight = node->mHeight;
+        heights[offset] = node->mHeight;
 
+        ipoint.mParentBegin = mParentIndices.size();
         for(const auto& pnode : node->mParents)
         {
-            auto& parent = mInterPointGraph[FindNodeOffset(nodeLayout, pnode)];
-            point.mParents.push_back(&parent);
-            parent.mChildren.push_back(&point);
+            auto parent = FindNodeOffset(layoutOffsets, pnode);
+            mParentIndices.push_back(parent);
+            children[parent].push_back(offset);
         }
+        ipoint.mParentEnd = mParentIndices.size();
 
-        point.mComputeFunction = LookupComputeFunction(node);
-        point.mPoint = &mPoints[offset];
+        ipoint.mOp = LookupOpCode(node);
+        if(ipoint.mOp == OP_STORE) ++numStores;
+        if(ipoint.mOp >= OP_ROLLING_SUM)
+        {
+            ipoint.mWindow = mWindows.size();
+            mWindows.emplace_back(ipoint.mOp, GetWindowSize(node));
+            mRollingPoints.push_back(offset);
+        }
 
         if(node->mKind == Node::KIND_CONST)
         {
-            *point.mPoint = std::stod(node->mToken);
+            point = std::stod(node->mToken);
         }
         else if(node->mKind == Node::KIND_VAR)
         {
-            *point.mPoint = node->mInitValue;
+            point = node->mInitValue;
         }
 
         if(node->mInputOffset >= 0)
         {
             for(const auto& label : node->mInputLabels)
             {
-                mInputs[label] = point.mPoint;
+                mLabels->mInputOffsets[label] = offset;
             }
-            point.mPoint->mLength = node->mLength;
+            point.mLength = node->mLength;
         }
         if(node->mObserverOffset >= 0)
         {
             for(const auto& label : node->mObserverLabels)
             {
-                mObservers[label] = point.mPoint;
+                mLabels->mObserverOffsets[label] = offset;
             }
-            point.mPoint->mLength = node->mLength;
+            point.mLength = node->mLength;
         }
-        mRecomputeHeap.emplace(HeightPtrPair{point.mHeight, &point});
     }
 
+    // A store computes at most once a stabilize so this never grows
+    mDirtyStores.reserve(numStores);
+
+    for(size_t i = 0; i < children.size(); ++i)
+    {
+        auto& ipoint = mInterPointGraph[i];
+        ipoint.mChildBegin = mChildIndices.size();
+        mChildIndices.insert(mChildIndices.end(), children[i].begin(), children[i].end());
+        ipoint.mChildEnd = mChildIndices.size();
+    }
+
+    // Layout heights are sparse so rank them to index the buckets
+    std::vector<int64_t> ranked(heights);
+    std::sort(ranked.begin(), ranked.end());
+    ranked.erase(std::unique(ranked.begin(), ranked.end()), ranked.end());
+
+    mRecomputeBuckets.resize(ranked.size());
+    std::vector<size_t> bucketSizes(ranked.size(), 0);
+    for(size_t i = 0; i < mInterPointGraph.size(); ++i)
+    {
+        auto& ipoint = mInterPointGraph[i];
+        ipoint.mHeight = std::distance(ranked.begin(),
+            std::lower_bound(ranked.begin(), ranked.end(), heights[i]));
+        ++bucketSizes[ipoint.mHeight];
+    }
+    for(size_t i = 0; i < bucketSizes.size(); ++i)
+    {
+        mRecomputeBuckets[i].reserve(bucketSizes[i]);
+    }
+
+    for(size_t i = 0; i < mInterPointGraph.size(); ++i)
+    {
+        Schedule(i);
+    }
+
+    mGraph->ReleaseBuildState();
     Stabilize();
 }
 
-bool Interpreter::IsDirty() const
+void Interpreter::Schedule(uint32_t index)
 {
-    for(const auto& namep : mInputs)
+    auto& ipoint = mInterPointGraph[index];
+    if(ipoint.mQueued) return;
+    ipoint.mQueued = true;
+    mRecomputeBuckets[ipoint.mHeight].push_back(index);
+    mTopQueued = std::max<int64_t>(mTopQueued, ipoint.mHeight);
+    ++mNumQueued;
+}
+
+void Interpreter::ScheduleChildren(uint32_t index)
+{
+    const auto& ipoint = mInterPointGraph[index];
+    for(auto c = ipoint.mChildBegin; c != ipoint.mChildEnd; ++c)
     {
-        auto& interpoint = *namep.second;
-        if(interpoint.IsDirty()) return true;
+        Schedule(mChildIndices[c]);
+    }
+}
+
+void Interpreter::Compute(uint32_t index)
+{
+    const auto& ipoint = mInterPointGraph[index];
+    const Point* points = mPoints.data();
+    const uint32_t* p = mParentIndices.data() + ipoint.mParentBegin;
+    const uint32_t* end = mParentIndices.data() + ipoint.mParentEnd;
+    auto& point = mPoints[index];
+
+    switch(ipoint.mOp)
+    {
+        case OP_NONE:    break;
+        case OP_TERNARY: Ternary(point, points, p, end); break;
+        case OP_ADD:     LoopOperator<std::plus<double>>(point, points, p, end); break;
+        case OP_SUB:     LoopOperator<std::minus<double>>(point, points, p, end); break;
+        case OP_DIV:     LoopOperator<std::divides<double>>(point, points, p, end); break;
+        case OP_MUL:     LoopOperator<std::multiplies<double>>(point, points, p, end); break;
+        case OP_MOD:     LoopOperator<ModFunc>(point, points, p, end); break;
+        case OP_LT:      PairOperator<std::less<double>>(point, points, p, end); break;
+        case OP_LE:      PairOperator<std::less_equal<double>>(point, points, p, end); break;
+        case OP_GT:      PairOperator<std::greater<double>>(point, points, p, end); break;
+        case OP_GE:      PairOperator<std::greater_equal<double>>(point, points, p, end); break;
+        case OP_EQ:      PairOperator<std::equal_to<double>>(point, points, p, end); break;
+        case OP_NE:      PairOperator<std::not_equal_to<double>>(point, points, p, end); break;
+        case OP_AND:     LoopOperator<std::logical_and<double>>(point, points, p, end); break;
+        case OP_OR:      LoopOperator<std::logical_or<double>>(point, points, p, end); break;
+        case OP_MIN:     LoopOperator<MinFunc>(point, points, p, end); break;
+        case OP_MAX:     LoopOperator<MaxFunc>(point, points, p, end); break;
+        case OP_EXP:     UnaryOperator<ExpFunc>(point, points, p, end); break;
+        case OP_LN:      UnaryOperator<LogFunc>(point, points, p, end); break;
+        case OP_TRUNC:   UnaryOperator<TruncFunc>(point, points, p, end); break;
+        case OP_NOT:     UnaryOperator<std::logical_not<double>>(point, points, p, end); break;
+        case OP_TICK:    point = point.mVal + 1; break;
+        case OP_COPY:    Copy(point, points, p, end); break;
+        case OP_STORE:
+        {
+            assert(end - p == 2);
+            mPoints[p[0]] = points[p[1]];
+            point = points[p[1]];
+            mDirtyStores.push_back(p[0]);
+        }
+        break;
+        case OP_ROLLING_SUM:
+        case OP_ROLLING_MEAN:
+        case OP_ROLLING_MIN:
+        case OP_ROLLING_MAX:
+        {
+            assert(end - p == 3);
+            auto& window = mWindows[ipoint.mWindow];
+            if(points[p[1]].mVal) window.Push(points[p[2]].mVal);
+            point = window.Get();
+        }
+        break;
     }
-    return false;
 }
 
 void Interpreter::Stabilize(bool force)
 {
-    for(const auto& namep : mInputs)
+    const bool stats = mStats.IsEnabled();
+    const uint64_t start = stats ? StatsRecorder::Now() : 0;
+    uint64_t dirtyInputs = 0;
+
+    for(const auto& namep : mLabels->mInputOffsets)
     {
-        auto& point = *namep.second;
+        auto& point = mPoints[namep.second];
         if(force || point.IsDirty())
         {
-            auto& interpoint = mInterPointGraph[&point - &mPoints.front()];
-            for(auto* child : interpoint.mChildren)
-            {
-                mRecomputeHeap.emplace(HeightPtrPair{child->mHeight, child});
-            }
+            ScheduleChildren(namep.second);
             point.Clean();
+            ++dirtyInputs;
         }
     }
 
     for(const auto ds : mDirtyStores)
     {
-        for(auto* child : ds->mChildren)
-        {
-            mRecomputeHeap.emplace(HeightPtrPair{child->mHeight, child});
-        }
+        ScheduleChildren(ds);
     }
     mDirtyStores.clear();
-    for(auto& hpp : mRecomputeHeap)
+
+    for(const auto rp : mRollingPoints)
     {
-        auto& interpoint = *hpp.point;
-        interpoint.mComputeFunction(interpoint);
-        if(interpoint.IsDirty())
-        {
-            for(auto* child : interpoint.mChildren)
-            {
-                mRecomputeHeap.emplace(HeightPtrPair{child->mHeight, child});
-            }
-            interpoint.Clean();
-        }
+        Schedule(rp);
     }
-    mRecomputeHeap.clear();
-}
 
-bool Interpreter::HasInputPoint(const std::string& label) const
-{
-    auto niter = mInputs.find(label);
-    return niter != mInputs.end();
-}
-
-Point& Interpreter::LookupInputPoint(const std::string& label)
-{
-    assert(HasInputPoint(label));
-    auto niter = mInputs.find(label);
-    return *niter->second;
-}
-
-std::vector<std::string> Interpreter::GetInputPointLabels() const
-{
-    std::vector<std::string> ret;
-    for(const auto& ip : mInputs)
+    const auto computed = mProfiling ? RecomputeQueued<true>() : RecomputeQueued<false>();
+    if(stats)
     {
-        ret.push_back(ip.first);
+        mStats.RecordStabilize(StatsRecorder::Now() - start, dirtyInputs, computed);
     }
-    return ret;
 }
 
-std::vector<std::pair<std::string, double>> Interpreter::DumpInputs() const
+template<bool Profiling>
+size_t Interpreter::RecomputeQueued()
 {
-    std::vector<std::pair<std::string, double>> ret;
-    for(const auto& ip : mInputs)
+    size_t computed = 0;
+    // Children always sit lower than their parents
+    // so a bucket never grows while we walk it
+    for(int64_t height = mTopQueued; mNumQueued && height >= 0; --height)
     {
-        ret.push_back(std::make_pair(ip.first, ip.second->mVal));
+        auto& bucket = mRecomputeBuckets[height];
+        for(auto index : bucket)
+        {
+            mInterPointGraph[index].mQueued = false;
+            --mNumQueued;
+            ++computed;
+            uint64_t start = 0;
+            if(Profiling) start = ReadCycleCounter();
+            Compute(index);
+            auto& point = mPoints[index];
+            if(Profiling)
+            {
+                auto& profile = mProfile[index];
+                profile.mCycles += ReadCycleCounter() - start;
+                ++profile.mEvaluations;
+                if(point.IsDirty()) ++profile.mChanges;
+            }
+            if(point.IsDirty())
+            {
+                ScheduleChildren(index);
+                point.Clean();
+            }
+        }
+        bucket.clear();
     }
-    return ret;
+    mTopQueued = -1;
+    return computed;
 }
 
-bool Interpreter::HasObserverPoint(const std::string& label) const
+void Interpreter::SetProfiling(bool enable)
 {
-    auto niter = mObservers.find(label);
-    return niter != mObservers.end();
+    mProfiling = enable;
+    mProfile.resize(mPoints.size());
 }
 
-Point& Interpreter::LookupObserverPoint(const std::string& label)
+void Interpreter::ResetProfile()
 {
-    assert(HasObserverPoint(label));
-    auto niter = mObservers.find(label);
-    return *niter->second;
+    mProfile.assign(mPoints.size(), InterPointProfile());
 }
 
-std::vector<std::string> Interpreter::GetObserverPointLabels() const
+std::vector<NodeProfile> Interpreter::GetProfile() const
 {
-    std::vector<std::string> ret;
-    for(const auto& ip : mObservers)
+    std::vector<NodeProfile> ret;
+    for(size_t i = 0; i < mProfile.size(); ++i)
     {
-        ret.push_back(ip.first);
+        const auto& counts = mProfile[i];
+        if(!counts.mEvaluations) continue;
+
+        auto np = GetNodeProfile(mNodeLayout[i]);
+        np.mEvaluations = counts.mEvaluations;
+        np.mChanges = counts.mChanges;
+        np.mCycles = counts.mCycles;
+        ret.push_back(np);
     }
+    SortProfile(ret);
     return ret;
 }
 
-std::vector<std::pair<std::string, double>> Interpreter::DumpObservers() const
+std::string Interpreter::GetProfileReport() const
 {
-    std::vector<std::pair<std::string, double>> ret;
-    for(const auto& ip : mObservers)
-    {
-        ret.push_back(std::make_pair(ip.first, ip.second->mVal));
-    }
-    return ret;
+    return FormatProfileReport(GetProfile());
+}
+
+std::string Interpreter::GetProfileDOTGraph() const
+{
+    return "digraph " + mGraph->GetDOTGraph(GetProfile());
 }
 
 bool Interpreter::SupportSimulation() const
@@ -395,11 +551,13 @@ int Interpreter::GetNumSimulationFunctions() const
 void Interpreter::CaptureState()
 {
     mCapturedState = mPoints;
+    mCapturedWindows = mWindows;
 }
 
 void Interpreter::ResetState()
 {
     mPoints = mCapturedState;
+    mWindows = mCapturedWindows;
 }
 
 bool Interpreter::RunSimulationId(int simId)
@@ -431,6 +589,7 @@ std::unique_ptr<IEngine> Interpreter::Build(const std::string& text)
     auto interpreter = std::unique_ptr<Interpreter>(new Interpreter());
     auto graph = interpreter->BuildAndLoadGraph();
     graph->Construct(Parse(text));
+    graph->Optimise();
     interpreter->AssignGraph(graph);
     interpreter->CompleteBuild();
     return std::unique_ptr<IEngine>(std::move(interpreter));
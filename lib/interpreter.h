@@ -7,33 +7,97 @@
 #include <set>
 
 #include "exys.h"
+#include "pointengine.h"
 
 namespace Exys
 {
 
-struct InterPoint;
-
-typedef std::function<void (InterPoint&)> ComputeFunction;
+enum OpCode : uint8_t
+{
+    OP_NONE,
+    OP_TERNARY,
+    OP_ADD,
+    OP_SUB,
+    OP_DIV,
+    OP_MUL,
+    OP_MOD,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_OR,
+    OP_MIN,
+    OP_MAX,
+    OP_EXP,
+    OP_LN,
+    OP_TRUNC,
+    OP_NOT,
+    OP_TICK,
+    OP_COPY,
+    OP_STORE,
+    OP_ROLLING_SUM,
+    OP_ROLLING_MEAN,
+    OP_ROLLING_MIN,
+    OP_ROLLING_MAX
+};
 
 struct InterPointProcessor
 {
     Procedure procedure;
-    std::function<ComputeFunction ()> func;
+    OpCode op;
 };
 
+// Point i of the graph always writes mPoints[i]. Parents and
+// children are ranges into flat index arrays held by the interpreter
 struct InterPoint
 {
-    int64_t mHeight;
-    std::vector<InterPoint*> mParents;
-    std::vector<InterPoint*> mChildren;
-    Point* mPoint;
-    ComputeFunction mComputeFunction;
-
-    bool IsDirty() const { return mPoint->mDirty; };
-    void Clean() { mPoint->mDirty = false; };
+    OpCode mOp = OP_NONE;
+    bool mQueued = false;
+    uint32_t mHeight = 0;
+    uint32_t mParentBegin = 0;
+    uint32_t mParentEnd = 0;
+    uint32_t mChildBegin = 0;
+    uint32_t mChildEnd = 0;
+    // Into the interpreter's windows for rolling procedures
+    uint32_t mWindow = 0;
+};
+
+// The last size values pushed to a rolling procedure. Sums are kept
+// running and min and max keep a queue of the positions that can still
+// become the extreme, oldest first, so every push is amortised O(1)
+class RollingWindow
+{
+public:
+    RollingWindow(OpCode op, uint32_t size);
+
+    void Push(double val);
+    double Get() const;
+
+private:
+    OpCode mOp;
+    std::vector<double> mValues;
+    uint32_t mHead = 0;
+    uint32_t mCount = 0;
+    double mSum = 0.0;
+
+    // Ring of positions in mValues
+    std::vector<uint32_t> mQueue;
+    uint32_t mQueueHead = 0;
+    uint32_t mQueueSize = 0;
+};
+
+// Counted for each point while profiling
+struct InterPointProfile
+{
+    uint64_t mEvaluations = 0;
+    uint64_t mChanges = 0;
+    uint64_t mCycles = 0;
 };
 
-class Interpreter : public IEngine
+class Interpreter : public PointEngine
 {
 public:
     Interpreter();
@@ -41,17 +105,6 @@ public:
     virtual ~Interpreter() {}
 
     void Stabilize(bool force=false) override;
-    bool IsDirty() const override;
-
-    bool HasInputPoint(const std::string& label) const override;
-    Point& LookupInputPoint(const std::string& label) override;
-    std::vector<std::string> GetInputPointLabels() const override;
-    std::vector<std::pair<std::string, double>> DumpInputs() const override;
-
-    bool HasObserverPoint(const std::string& label) const override;
-    Point& LookupObserverPoint(const std::string& label) override;
-    std::vector<std::string> GetObserverPointLabels() const override;
-    std::vector<std::pair<std::string, double>> DumpObservers() const override;
 
     bool SupportSimulation() const override;
     int GetNumSimulationFunctions() const override;
@@ -62,39 +115,51 @@ public:
 
     std::string GetDOTGraph() const override;
 
+    // Off by default. Cycles are read with rdtsc around each evaluation
+    void SetProfiling(bool enable);
+    void ResetProfile();
+    std::vector<NodeProfile> GetProfile() const;
+    std::string GetProfileReport() const;
+    std::string GetProfileDOTGraph() const;
+
     static std::unique_ptr<IEngine> Build(const std::string& text);
 
 private:
     void AssignGraph(std::unique_ptr<Graph>& graph);
     void CompleteBuild();
-    void TraverseNodes(Node::Ptr node, uint64_t& height, std::set<Node::Ptr>& necessaryNodes);
     void CollectListMembers(Node::Ptr node, std::vector<Node::Ptr>& nodes);
-    ComputeFunction LookupComputeFunction(Node::Ptr node);
+    OpCode LookupOpCode(Node::Ptr node);
     std::unique_ptr<Graph> BuildAndLoadGraph();
 
-    void Store(InterPoint& ipoint);
+    void Compute(uint32_t index);
+    template<bool Profiling> size_t RecomputeQueued();
+    void Schedule(uint32_t index);
+    void ScheduleChildren(uint32_t index);
     
-    std::unordered_map<std::string, Point*> mObservers;
-    std::unordered_map<std::string, Point*> mInputs;
-
     std::vector<InterPoint> mInterPointGraph;
-    std::vector<Point> mPoints;
+    std::vector<uint32_t> mParentIndices;
+    std::vector<uint32_t> mChildIndices;
     std::vector<Point> mCapturedState;
-    std::vector<InterPoint*> mDirtyStores;
-
-    struct HeightPtrPair
-    {
-        int64_t height;
-        InterPoint* point;
-
-        bool operator<(const HeightPtrPair& rhs) const
-        {
-            return ((height > rhs.height) || ((height == rhs.height) && (point > rhs.point)));
-        }
-    };
-    std::set<HeightPtrPair> mRecomputeHeap; // height -> Nodes
+    std::vector<uint32_t> mDirtyStores;
+    std::vector<RollingWindow> mWindows;
+    std::vector<RollingWindow> mCapturedWindows;
+
+    // Rolling points take their gated value on every stabilize,
+    // same as the jitted code, not only when a parent changed
+    std::vector<uint32_t> mRollingPoints;
+
+    // Points waiting on recompute bucketed by height. Each
+    // bucket is reserved for every point of that height
+    std::vector<std::vector<uint32_t>> mRecomputeBuckets;
+    int64_t mTopQueued = -1;
+    size_t mNumQueued = 0;
+    bool mProfiling = false;
+    std::vector<InterPointProfile> mProfile;
+
     std::unique_ptr<Graph> mGraph;
+    std::vector<Node::Ptr> mNodeLayout;
     std::vector<InterPointProcessor> mPointProcessors;
+    std::vector<int> mProcessorIndex;
 };
 
 };
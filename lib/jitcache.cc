@@ -0,0 +1,138 @@
+#ifndef _WIN32
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <unistd.h>
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "jitcache.h"
+#include "jitter.h"
+
+namespace
+{
+    constexpr char EXYS_JIT_CACHE[] = "EXYS_JIT_CACHE";
+    constexpr char KEY_PREFIX[] = "exys-";
+
+    // FNV-1a so keys are the same from one build to the next
+    uint64_t HashText(llvm::StringRef text, uint64_t hash=14695981039346656037ull)
+    {
+        for(unsigned char c : text)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Objects are followed by their hash. One that was cut short or
+    // damaged is thrown away so the module compiles and writes it again
+    std::unique_ptr<llvm::MemoryBuffer> LoadObject(const std::string& path)
+    {
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if(!buffer) return nullptr;
+
+        auto contents = buffer.get()->getBuffer();
+        uint64_t hash = 0;
+        const bool complete = contents.size() > sizeof(hash);
+        if(complete)
+        {
+            contents = contents.substr(0, contents.size() - sizeof(hash));
+            std::memcpy(&hash, contents.end(), sizeof(hash));
+        }
+        if(!complete || (HashText(contents) != hash))
+        {
+            std::remove(path.c_str());
+            return nullptr;
+        }
+        return llvm::MemoryBuffer::getMemBufferCopy(contents, path);
+    }
+}
+
+namespace Exys
+{
+
+JitObjectCache::JitObjectCache(const std::string& directory)
+: mDirectory(directory)
+{
+    llvm::sys::fs::create_directories(mDirectory);
+}
+
+std::unique_ptr<JitObjectCache> JitObjectCache::FromEnvironment()
+{
+    const char* directory = getenv(EXYS_JIT_CACHE);
+    if(!directory || !*directory) return nullptr;
+    return std::unique_ptr<JitObjectCache>(new JitObjectCache(directory));
+}
+
+std::string JitObjectCache::GetModuleKey(const llvm::Module& M)
+{
+    std::string ir;
+    llvm::raw_string_ostream irStream(ir);
+    M.print(irStream, nullptr);
+    irStream.flush();
+
+    uint64_t hash = HashText(ir);
+    hash = HashText(LLVM_VERSION_STRING, hash);
+    hash = HashText(llvm::sys::getProcessTriple(), hash);
+    hash = HashText(llvm::sys::getHostCPUName().str(), hash);
+    for(const auto& feature : GetHostCpuFeatures())
+    {
+        hash = HashText(feature, hash);
+    }
+
+    std::stringstream key;
+    key << KEY_PREFIX << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return key.str();
+}
+
+std::string JitObjectCache::GetPath(const std::string& key) const
+{
+    return mDirectory + "/" + key + ".o";
+}
+
+bool JitObjectCache::HasObject(const std::string& key) const
+{
+    return LoadObject(GetPath(key)) != nullptr;
+}
+
+void JitObjectCache::notifyObjectCompiled(const llvm::Module* M, llvm::MemoryBufferRef obj)
+{
+    const auto& key = M->getModuleIdentifier();
+    if(key.compare(0, sizeof(KEY_PREFIX) - 1, KEY_PREFIX) != 0) return;
+
+    // Write then rename so a reader never sees half an object
+    const auto path = GetPath(key);
+    const auto tmpPath = path + ".tmp" + std::to_string(getpid());
+    {
+        const uint64_t hash = HashText(obj.getBuffer());
+        std::ofstream out(tmpPath, std::ios::binary);
+        out.write(obj.getBufferStart(), obj.getBufferSize());
+        out.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+        if(!out.good()) 
+        {
+            std::remove(tmpPath.c_str());
+            return;
+        }
+    }
+    std::rename(tmpPath.c_str(), path.c_str());
+}
+
+std::unique_ptr<llvm::MemoryBuffer> JitObjectCache::getObject(const llvm::Module* M)
+{
+    const auto& key = M->getModuleIdentifier();
+    if(key.compare(0, sizeof(KEY_PREFIX) - 1, KEY_PREFIX) != 0) return nullptr;
+    return LoadObject(GetPath(key));
+}
+
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _WIN32
+#pragma once
+
+#include <string>
+#include <memory>
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+
+namespace Exys
+{
+
+// Keeps compiled modules on disk so a restart or reload of the same
+// graph can skip optimisation and code generation. Modules are keyed
+// on their unoptimised IR and the target they are compiled for
+class JitObjectCache : public llvm::ObjectCache
+{
+public:
+    explicit JitObjectCache(const std::string& directory);
+
+    // Cache in the directory named by EXYS_JIT_CACHE or null if unset
+    static std::unique_ptr<JitObjectCache> FromEnvironment();
+    static std::string GetModuleKey(const llvm::Module& M);
+
+    // Only true for a whole object. Damaged ones are removed
+    bool HasObject(const std::string& key) const;
+
+    void notifyObjectCompiled(const llvm::Module* M, llvm::MemoryBufferRef obj) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* M) override;
+
+private:
+    std::string GetPath(const std::string& key) const;
+
+    std::string mDirectory;
+};
+
+};
+#endif
@@ -0,0 +1,172 @@
+#ifndef _WIN32
+
+#include <iostream>
+#include <cassert>
+
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/Support/Host.h"
+
+#include "jitmulti.h"
+
+namespace Exys
+{
+
+JitMulti::JitMulti(std::unique_ptr<Jitter> jitter, size_t numInstances)
+: mNumInstances(numInstances)
+, mJitter(std::move(jitter))
+{
+}
+
+JitMulti::~JitMulti()
+{
+}
+
+std::string JitMulti::GetDOTGraph() const
+{
+    return mJitter->GetDOTGraph();
+}
+
+void JitMulti::BuildJitEngine(std::unique_ptr<llvm::Module> module)
+{
+    std::string error;
+    mExecEngine.reset(llvm::EngineBuilder(std::move(module))
+                                .setEngineKind(llvm::EngineKind::JIT)
+                                .setOptLevel(llvm::CodeGenOpt::Level::Aggressive)
+                                .setMCPU(llvm::sys::getHostCPUName())
+                                .setMAttrs(GetHostCpuFeatures())
+                                .setErrorStr(&error)
+                                .create());
+    auto* llvmExecEngine = mExecEngine.get();
+    if(!llvmExecEngine)
+    {
+        std::cout << error;
+        assert(llvmExecEngine);
+    }
+    if(mObjectCache)
+    {
+        llvmExecEngine->setObjectCache(mObjectCache.get());
+    }
+    llvmExecEngine->DisableGVCompilation(true);
+
+    mRawStabilizeFunc = reinterpret_cast<MultiStabilizationFunc>(
+            llvmExecEngine->getPointerToNamedFunction(MULTI_STAB_FUNC_NAME));
+    auto initFunc = reinterpret_cast<InitFunc>(llvmExecEngine->getPointerToNamedFunction(INIT_FUNC_NAME));
+
+    llvmExecEngine->finalizeObject();
+
+    // Setup memory
+    const auto& inputDesc = mJitter->GetInputDesc();
+    const auto& observerDesc = mJitter->GetObserverDesc();
+    mInputs.resize(inputDesc.size() * mNumInstances);
+    mObservers.resize(observerDesc.size() * mNumInstances);
+    mState.resize(mJitter->GetStateSpaceSize() * mNumInstances);
+
+    for(const auto& id : inputDesc)
+    {
+        for(const auto& label : id->mInputLabels)
+        {
+            mInputOffsets[label] = id->mInputOffset;
+        }
+    }
+    for(const auto& od : observerDesc)
+    {
+        for(const auto& label : od->mObserverLabels)
+        {
+            mObserverOffsets[label] = od->mObserverOffset;
+        }
+    }
+
+    // Init writes one instance worth of state which is copied down each column
+    std::vector<double> initialState(mJitter->GetStateSpaceSize());
+    initFunc(initialState.data());
+    for(size_t slot = 0; slot < initialState.size(); ++slot)
+    {
+        auto column = mState.begin() + slot * mNumInstances;
+        std::fill(column, column + mNumInstances, initialState[slot]);
+    }
+}
+
+void JitMulti::CompleteBuild()
+{
+    assert(mJitter && "Can only build with underlying jitter");
+    InitializeHostTarget();
+
+    mJitter->SetMultiInstance(true);
+    if(!mObjectCache) mObjectCache = JitObjectCache::FromEnvironment();
+    BuildJitEngine(mJitter->BuildModule(mObjectCache.get()));
+
+    Stabilize();
+}
+
+void JitMulti::Stabilize()
+{
+    mRawStabilizeFunc(mInputs.data(), mObservers.data(), mState.data(), mNumInstances);
+}
+
+InputHandle JitMulti::ResolveInput(const std::string& label) const
+{
+    InputHandle handle;
+    auto niter = mInputOffsets.find(label);
+    if(niter != mInputOffsets.end())
+    {
+        handle.mIndex = niter->second;
+    }
+    return handle;
+}
+
+double* JitMulti::GetInputColumn(InputHandle handle)
+{
+    assert((handle.mIndex + 1) * mNumInstances <= mInputs.size());
+    return mInputs.data() + handle.mIndex * mNumInstances;
+}
+
+void JitMulti::SetInput(InputHandle handle, size_t instance, double value)
+{
+    assert(instance < mNumInstances);
+    GetInputColumn(handle)[instance] = value;
+}
+
+ObserverHandle JitMulti::ResolveObserver(const std::string& label) const
+{
+    ObserverHandle handle;
+    auto niter = mObserverOffsets.find(label);
+    if(niter != mObserverOffsets.end())
+    {
+        handle.mIndex = niter->second;
+    }
+    return handle;
+}
+
+const double* JitMulti::GetObserverColumn(ObserverHandle handle) const
+{
+    assert((handle.mIndex + 1) * mNumInstances <= mObservers.size());
+    return mObservers.data() + handle.mIndex * mNumInstances;
+}
+
+double JitMulti::ReadObserver(ObserverHandle handle, size_t instance) const
+{
+    assert(instance < mNumInstances);
+    return GetObserverColumn(handle)[instance];
+}
+
+std::unique_ptr<JitMulti> JitMulti::Build(const std::string& text, size_t numInstances)
+{
+    auto jitter = Jitter::Build(text);
+    auto engine = std::unique_ptr<JitMulti>(new JitMulti(std::move(jitter), numInstances));
+    engine->CompleteBuild();
+    return engine;
+}
+
+std::unique_ptr<JitMulti> JitMulti::Build(const std::string& text, size_t numInstances,
+        const std::string& cacheDirectory)
+{
+    auto jitter = Jitter::Build(text);
+    auto engine = std::unique_ptr<JitMulti>(new JitMulti(std::move(jitter), numInstances));
+    engine->mObjectCache.reset(new JitObjectCache(cacheDirectory));
+    engine->CompleteBuild();
+    return engine;
+}
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _WIN32
+#pragma once
+
+#include <string>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+
+#include "exys.h"
+#include "jitter.h"
+#include "jitcache.h"
+
+namespace Exys
+{
+
+// Runs many instances of one graph in lock step. Values are held
+// column wise - all instances of an input sit next to each other -
+// so a single stabilize can work across instances with vector
+// instructions. Every stabilize recomputes every instance.
+class JitMulti
+{
+public:
+    JitMulti(std::unique_ptr<Jitter> jitter, size_t numInstances);
+    virtual ~JitMulti();
+
+    void Stabilize();
+
+    size_t GetNumInstances() const { return mNumInstances; }
+
+    // Elements of a list input or observer are in consecutive columns
+    // so element i of a handle is at column handle.mIndex + i
+    InputHandle ResolveInput(const std::string& label) const;
+    double* GetInputColumn(InputHandle handle);
+    void SetInput(InputHandle handle, size_t instance, double value);
+
+    ObserverHandle ResolveObserver(const std::string& label) const;
+    const double* GetObserverColumn(ObserverHandle handle) const;
+    double ReadObserver(ObserverHandle handle, size_t instance) const;
+
+    std::string GetDOTGraph() const;
+
+    // Compiled code is cached in EXYS_JIT_CACHE if set or cacheDirectory
+    static std::unique_ptr<JitMulti> Build(const std::string& text, size_t numInstances);
+    static std::unique_ptr<JitMulti> Build(const std::string& text, size_t numInstances,
+            const std::string& cacheDirectory);
+
+private:
+    void BuildJitEngine(std::unique_ptr<llvm::Module> module);
+    void CompleteBuild();
+
+    MultiStabilizationFunc mRawStabilizeFunc = nullptr;
+
+    size_t mNumInstances = 0;
+    std::vector<double> mInputs;
+    std::vector<double> mObservers;
+    std::vector<double> mState;
+    std::unordered_map<std::string, int> mInputOffsets;
+    std::unordered_map<std::string, int> mObserverOffsets;
+
+    // Destroyed bottom up so the engine goes before the context
+    std::unique_ptr<JitObjectCache> mObjectCache;
+    std::unique_ptr<Jitter> mJitter;
+    std::unique_ptr<llvm::ExecutionEngine> mExecEngine;
+};
+
+};
+#endif
@@ -0,0 +1,95 @@
+#ifndef _WIN32
+
+#include <algorithm>
+
+#include "jitsession.h"
+#include "jitwrap.h"
+
+namespace Exys
+{
+
+JitSession::JitSession(size_t numThreads)
+{
+    // Before any thread so they never race to register it
+    InitializeHostTarget();
+    for(size_t i = 0; i < numThreads; ++i)
+    {
+        mThreads.emplace_back(&JitSession::WorkerLoop, this);
+    }
+}
+
+JitSession::~JitSession()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWork.notify_all();
+    for(auto& thread : mThreads)
+    {
+        thread.join();
+    }
+}
+
+JitSession& JitSession::Get()
+{
+    static JitSession session(std::max(1u, std::thread::hardware_concurrency()));
+    return session;
+}
+
+void JitSession::Post(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(std::move(job));
+    }
+    mWork.notify_one();
+}
+
+void JitSession::WorkerLoop()
+{
+    for(;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWork.wait(lock, [this]{ return mStop || !mJobs.empty(); });
+            // Stop only once everything queued has run
+            if(mJobs.empty()) return;
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+        job();
+    }
+}
+
+std::future<std::unique_ptr<IEngine>> JitSession::BuildAsync(const std::string& text)
+{
+    // Jobs have to be copyable to go in a function
+    auto build = std::make_shared<std::packaged_task<std::unique_ptr<IEngine>()>>([text]
+    {
+        return JitWrap::Build(text);
+    });
+    Post([build]{ (*build)(); });
+    return build->get_future();
+}
+
+std::shared_ptr<IEngine> JitEngineSlot::Get() const
+{
+    return std::atomic_load(&mEngine);
+}
+
+std::future<void> JitEngineSlot::Load(const std::string& text, JitSession& session)
+{
+    auto load = std::make_shared<std::packaged_task<void()>>([this, text]
+    {
+        std::shared_ptr<IEngine> engine = JitWrap::Build(text);
+        std::atomic_store(&mEngine, engine);
+    });
+    session.Post([load]{ (*load)(); });
+    return load->get_future();
+}
+
+}
+
+#endif
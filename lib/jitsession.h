@@ -0,0 +1,63 @@
+#ifndef _WIN32
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+#include "exys.h"
+
+namespace Exys
+{
+
+// One per process. Compiles graphs on background threads so a host
+// can keep serving from one engine while the next is being built.
+// Each graph gets its own code which is unloaded with its last engine
+class JitSession
+{
+public:
+    // Hosts normally share the one from Get
+    explicit JitSession(size_t numThreads);
+    // Jobs already posted are run before the threads stop so
+    // nobody waiting on one is left with a broken promise
+    ~JitSession();
+
+    static JitSession& Get();
+
+    // Exceptions from the build are rethrown by the future
+    std::future<std::unique_ptr<IEngine>> BuildAsync(const std::string& text);
+
+    void Post(std::function<void()> job);
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> mThreads;
+    std::deque<std::function<void()>> mJobs;
+    std::mutex mMutex;
+    std::condition_variable mWork;
+    bool mStop = false;
+};
+
+// The engine a strategy is served from. Load builds the replacement on
+// the session and swaps it in when ready. Engines already handed out
+// by Get stay alive until their holders let them go
+class JitEngineSlot
+{
+public:
+    std::shared_ptr<IEngine> Get() const;
+
+    // The slot must outlive the returned future
+    std::future<void> Load(const std::string& text, JitSession& session=JitSession::Get());
+
+private:
+    std::shared_ptr<IEngine> mEngine;
+};
+
+};
+#endif
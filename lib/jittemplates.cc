@@ -0,0 +1,73 @@
+#ifndef _WIN32
+
+#include "jittemplates.h"
+
+namespace Exys
+{
+
+JitTemplateRegistry::JitTemplateRegistry()
+: mBuilder([](const std::string& text) { return JitWrap::Build(text); })
+{
+}
+
+JitTemplateRegistry::JitTemplateRegistry(Builder builder)
+: mBuilder(std::move(builder))
+{
+}
+
+JitTemplateRegistry::Template JitTemplateRegistry::GetTemplate(const std::string& text)
+{
+    std::promise<std::shared_ptr<JitWrap>> compiled;
+    Template result = compiled.get_future().share();
+    uint64_t compile = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto titer = mTemplates.find(text);
+        if(titer != mTemplates.end()) return titer->second.mTemplate;
+        compile = ++mNumCompiles;
+        mTemplates.emplace(text, Entry{result, compile});
+    }
+
+    // Compile outside the lock so other graphs aren't held up. Anyone
+    // asking for this one meanwhile waits on the future
+    try
+    {
+        auto engine = mBuilder(text);
+        compiled.set_value(std::shared_ptr<JitWrap>(static_cast<JitWrap*>(engine.release())));
+    }
+    catch(...)
+    {
+        // Waiters get the error and the next caller tries again. The
+        // graph may have been removed and asked for again meanwhile
+        compiled.set_exception(std::current_exception());
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto titer = mTemplates.find(text);
+        if((titer != mTemplates.end()) && (titer->second.mCompile == compile))
+        {
+            mTemplates.erase(titer);
+        }
+    }
+    return result;
+}
+
+std::unique_ptr<JitWrap> JitTemplateRegistry::Instantiate(const std::string& text)
+{
+    auto prototype = GetTemplate(text).get();
+    return std::unique_ptr<JitWrap>(new JitWrap(*prototype));
+}
+
+void JitTemplateRegistry::Remove(const std::string& text)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTemplates.erase(text);
+}
+
+size_t JitTemplateRegistry::GetNumTemplates() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTemplates.size();
+}
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef _WIN32
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <unordered_map>
+
+#include "exys.h"
+#include "jitwrap.h"
+
+namespace Exys
+{
+
+// Compiles each distinct graph once. Engines instantiated from it share
+// its code and labels and only own their points and state, so many
+// engines of one graph cost little more than their buffers
+class JitTemplateRegistry
+{
+public:
+    typedef std::function<std::unique_ptr<IEngine>(const std::string& text)> Builder;
+
+    // Graphs are compiled with JitWrap::Build unless given a builder.
+    // Engines from a builder have to be JitWraps too
+    JitTemplateRegistry();
+    explicit JitTemplateRegistry(Builder builder);
+
+    // Compiles the graph the first time its text is seen. Instances
+    // start from the state the graph has straight after building
+    std::unique_ptr<JitWrap> Instantiate(const std::string& text);
+
+    // Instances already made keep the code loaded
+    void Remove(const std::string& text);
+    size_t GetNumTemplates() const;
+
+private:
+    typedef std::shared_future<std::shared_ptr<JitWrap>> Template;
+    Template GetTemplate(const std::string& text);
+
+    // Futures can't be compared so each compile is numbered to
+    // tell whether the entry for a graph is still its own
+    struct Entry
+    {
+        Template mTemplate;
+        uint64_t mCompile;
+    };
+
+    Builder mBuilder;
+    mutable std::mutex mMutex;
+    std::unordered_map<std::string, Entry> mTemplates;
+    uint64_t mNumCompiles = 0;
+};
+
+};
+#endif
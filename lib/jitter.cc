@@ -3,6 +3,10 @@
 #include <iostream>
 #include <sstream>
 #include <cassert>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <mutex>
 
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/ADT/STLExtras.h"
@@ -21,8 +25,12 @@
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/IPO.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Support/Host.h"
 
 #include "jitter.h"
+#include "jitcache.h"
 #include "helpers.h"
 
 namespace Exys
@@ -72,12 +80,27 @@ llvm::Value* JitDoubleNot(llvm::Module*, llvm::IRBuilder<>& builder, const JitPo
 
 llvm::Value* Jitter::JitGV(llvm::Module* M, llvm::IRBuilder<>& builder)
 {
+    if(mMultiInstance)
+    {
+        return JitColumn(builder, mStatePtr, mNumStatePtr++);
+    }
+
     llvm::Value* stateIndex = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*mLlvmContext), mNumStatePtr++);
     std::vector<llvm::Value*> gepIndex;
     gepIndex.push_back(stateIndex);
     return builder.CreateGEP(mStatePtr, gepIndex);
 }
 
+// Address of the current instance in a column of a multi instance module
+llvm::Value* Jitter::JitColumn(llvm::IRBuilder<>& builder, llvm::Value* base, uint64_t column)
+{
+    assert(mMultiInstance && mInstanceIndex);
+    llvm::Value* columnStart = builder.CreateMul(builder.getInt64(column), mInstanceCount);
+    std::vector<llvm::Value*> gepIndex;
+    gepIndex.push_back(builder.CreateAdd(columnStart, mInstanceIndex));
+    return builder.CreateGEP(base, gepIndex);
+}
+
 llvm::Value* Jitter::JitLoad(llvm::Module* M, llvm::IRBuilder<>& builder, const JitPoint& point)
 {
     return builder.CreateLoad(point.mParents[0]->mValue);
@@ -104,6 +127,209 @@ llvm::Value* Jitter::JitTick(llvm::Module* M, llvm::IRBuilder<>& builder, const
     return ret;
 }
 
+// Rolling windows live in the state as
+//   sum and mean: head, count, sum, values[size]
+//   min and max:  head, count, queue head, queue size, values[size], queue[size]
+// with indices stored as doubles like everything else in there
+static int GetWindowSlots(Symbol symbol, uint32_t size)
+{
+    const bool sum = (symbol == SYMBOL_ROLLING_SUM) || (symbol == SYMBOL_ROLLING_MEAN);
+    return sum ? 3 + size : 4 + 2 * size;
+}
+
+// One function per kind of window, shared by every window of that kind
+// in the module. Takes the first slot of the window, the distance between
+// slots, the window size, the gate and the value. Does the same steps as
+// RollingWindow in the interpreter so both give identical results
+static llvm::Function* GetRollingFunction(llvm::Module* M, Symbol symbol)
+{
+    const auto name = "exys." + SymbolTable::Get().GetName(symbol);
+    if(auto* existing = M->getFunction(name)) return existing;
+
+    llvm::IRBuilder<> builder(M->getContext());
+    auto* doubleTy = builder.getDoubleTy();
+    auto* int64Ty = builder.getInt64Ty();
+    std::vector<llvm::Type*> argTypes;
+    argTypes.push_back(llvm::PointerType::get(doubleTy, 0));
+    argTypes.push_back(int64Ty);
+    argTypes.push_back(int64Ty);
+    argTypes.push_back(builder.getInt1Ty());
+    argTypes.push_back(doubleTy);
+    auto* func = llvm::Function::Create(llvm::FunctionType::get(doubleTy, argTypes, false),
+            llvm::GlobalValue::InternalLinkage, name, M);
+
+    auto args = func->arg_begin();
+    llvm::Value* window = &(*args++);
+    llvm::Value* stride = &(*args++);
+    llvm::Value* size = &(*args++);
+    llvm::Value* gate = &(*args++);
+    llvm::Value* val = &(*args++);
+
+    auto slot = [&](llvm::Value* index)
+    {
+        std::vector<llvm::Value*> gepIndex;
+        gepIndex.push_back(builder.CreateMul(index, stride));
+        return builder.CreateGEP(window, gepIndex);
+    };
+    auto load = [&](llvm::Value* index)
+    {
+        return builder.CreateLoad(slot(index));
+    };
+    auto loadIndex = [&](llvm::Value* index)
+    {
+        return builder.CreateFPToSI(load(index), int64Ty);
+    };
+    auto storeIndex = [&](llvm::Value* value, llvm::Value* index)
+    {
+        builder.CreateStore(builder.CreateSIToFP(value, doubleTy), slot(index));
+    };
+    // Steps an index into a ring of size along one
+    auto wrap = [&](llvm::Value* index)
+    {
+        return builder.CreateSelect(builder.CreateICmpSGE(index, size), builder.CreateSub(index, size), index);
+    };
+
+    auto* entry = llvm::BasicBlock::Create(M->getContext(), "entry", func);
+    auto* push = llvm::BasicBlock::Create(M->getContext(), "push", func);
+    auto* done = llvm::BasicBlock::Create(M->getContext(), "done", func);
+    builder.SetInsertPoint(entry);
+    builder.CreateCondBr(gate, push, done);
+
+    auto* zero = builder.getInt64(0);
+    auto* one = builder.getInt64(1);
+    auto* zeroFP = llvm::ConstantFP::get(doubleTy, 0.0);
+
+    builder.SetInsertPoint(push);
+    llvm::Value* head = loadIndex(builder.getInt64(0));
+    llvm::Value* count = loadIndex(builder.getInt64(1));
+    llvm::Value* full = builder.CreateICmpEQ(count, size);
+    count = builder.CreateSelect(full, count, builder.CreateAdd(count, one));
+
+    if((symbol == SYMBOL_ROLLING_SUM) || (symbol == SYMBOL_ROLLING_MEAN))
+    {
+        auto* valueSlot = slot(builder.CreateAdd(head, builder.getInt64(3)));
+        llvm::Value* sum = load(builder.getInt64(2));
+        sum = builder.CreateSelect(full, builder.CreateFSub(sum, builder.CreateLoad(valueSlot)), sum);
+        builder.CreateStore(val, valueSlot);
+        sum = builder.CreateFAdd(sum, val);
+        builder.CreateStore(sum, slot(builder.getInt64(2)));
+        storeIndex(count, builder.getInt64(1));
+        head = builder.CreateAdd(head, one);
+        auto* lap = builder.CreateICmpEQ(head, size);
+        storeIndex(builder.CreateSelect(lap, zero, head), builder.getInt64(0));
+
+        // Start again from the values once a lap so rounding
+        // errors and infinities don't stick around
+        auto* resum = llvm::BasicBlock::Create(M->getContext(), "resum", func);
+        auto* resumEnd = llvm::BasicBlock::Create(M->getContext(), "resum-end", func);
+        builder.CreateCondBr(lap, resum, done);
+
+        builder.SetInsertPoint(resum);
+        auto* i = builder.CreatePHI(int64Ty, 2);
+        auto* total = builder.CreatePHI(doubleTy, 2);
+        auto* nextTotal = builder.CreateFAdd(total, load(builder.CreateAdd(i, builder.getInt64(3))));
+        auto* next = builder.CreateAdd(i, one);
+        i->addIncoming(zero, push);
+        i->addIncoming(next, resum);
+        total->addIncoming(zeroFP, push);
+        total->addIncoming(nextTotal, resum);
+        builder.CreateCondBr(builder.CreateICmpEQ(next, size), resumEnd, resum);
+
+        builder.SetInsertPoint(resumEnd);
+        builder.CreateStore(nextTotal, slot(builder.getInt64(2)));
+        builder.CreateBr(done);
+
+        builder.SetInsertPoint(done);
+        llvm::Value* ret = load(builder.getInt64(2));
+        if(symbol == SYMBOL_ROLLING_MEAN)
+        {
+            auto* counted = load(builder.getInt64(1));
+            ret = builder.CreateSelect(builder.CreateFCmpOEQ(counted, zeroFP), zeroFP,
+                    builder.CreateFDiv(ret, counted));
+        }
+        builder.CreateRet(ret);
+        return func;
+    }
+
+    auto* valuesBase = builder.getInt64(4);
+    auto* queueBase = builder.CreateAdd(valuesBase, size);
+
+    // The oldest value is about to be overwritten
+    llvm::Value* queueHead = loadIndex(builder.getInt64(2));
+    llvm::Value* queueSize = loadIndex(builder.getInt64(3));
+    auto* oldest = loadIndex(builder.CreateAdd(queueBase, queueHead));
+    auto* expire = builder.CreateAnd(full, builder.CreateAnd(builder.CreateICmpNE(queueSize, zero),
+                builder.CreateICmpEQ(oldest, head)));
+    queueHead = builder.CreateSelect(expire, wrap(builder.CreateAdd(queueHead, one)), queueHead);
+    queueSize = builder.CreateSelect(expire, builder.CreateSub(queueSize, one), queueSize);
+    builder.CreateStore(val, slot(builder.CreateAdd(valuesBase, head)));
+
+    // Older values that can't beat the new one never will again
+    auto* pop = llvm::BasicBlock::Create(M->getContext(), "pop", func);
+    auto* popCheck = llvm::BasicBlock::Create(M->getContext(), "pop-check", func);
+    auto* append = llvm::BasicBlock::Create(M->getContext(), "append", func);
+    builder.CreateBr(pop);
+
+    builder.SetInsertPoint(pop);
+    auto* n = builder.CreatePHI(int64Ty, 2);
+    n->addIncoming(queueSize, push);
+    builder.CreateCondBr(builder.CreateICmpNE(n, zero), popCheck, append);
+
+    builder.SetInsertPoint(popCheck);
+    auto* back = wrap(builder.CreateSub(builder.CreateAdd(queueHead, n), one));
+    auto* old = load(builder.CreateAdd(valuesBase, loadIndex(builder.CreateAdd(queueBase, back))));
+    auto* beaten = (symbol == SYMBOL_ROLLING_MAX) ? builder.CreateFCmpOLE(old, val) : builder.CreateFCmpOGE(old, val);
+    n->addIncoming(builder.CreateSub(n, one), popCheck);
+    builder.CreateCondBr(beaten, pop, append);
+
+    builder.SetInsertPoint(append);
+    storeIndex(head, builder.CreateAdd(queueBase, wrap(builder.CreateAdd(queueHead, n))));
+    storeIndex(builder.CreateAdd(n, one), builder.getInt64(3));
+    storeIndex(queueHead, builder.getInt64(2));
+    storeIndex(count, builder.getInt64(1));
+    head = builder.CreateAdd(head, one);
+    storeIndex(builder.CreateSelect(builder.CreateICmpEQ(head, size), zero, head), builder.getInt64(0));
+    builder.CreateBr(done);
+
+    // Empty until the first push
+    builder.SetInsertPoint(done);
+    auto* counted = load(builder.getInt64(1));
+    auto* front = loadIndex(builder.CreateAdd(builder.CreateAdd(valuesBase, size), loadIndex(builder.getInt64(2))));
+    auto* extreme = load(builder.CreateAdd(valuesBase, front));
+    builder.CreateRet(builder.CreateSelect(builder.CreateFCmpOEQ(counted, zeroFP), zeroFP, extreme));
+    return func;
+}
+
+llvm::Value* Jitter::JitRolling(llvm::Module* M, llvm::IRBuilder<>& builder, const JitPoint& point)
+{
+    const auto symbol = point.mNode->mSymbol;
+    const auto size = GetWindowSize(point.mNode);
+
+    // Slots of a multi instance module are a column apart
+    auto* window = JitGV(M, builder);
+    mNumStatePtr += GetWindowSlots(symbol, size) - 1;
+    llvm::Value* stride = mMultiInstance ? mInstanceCount : builder.getInt64(1);
+
+    llvm::Value* gate = point.mParents[1]->mValue;
+    if(gate->getType() == builder.getDoubleTy())
+    {
+        gate = builder.CreateFCmpUNE(gate, llvm::ConstantFP::get(builder.getDoubleTy(), 0.0));
+    }
+    llvm::Value* val = point.mParents[2]->mValue;
+    if(val->getType() != builder.getDoubleTy())
+    {
+        val = builder.CreateUIToFP(val, builder.getDoubleTy());
+    }
+
+    std::vector<llvm::Value*> args;
+    args.push_back(window);
+    args.push_back(stride);
+    args.push_back(builder.getInt64(size));
+    args.push_back(gate);
+    args.push_back(val);
+    return builder.CreateCall(GetRollingFunction(M, symbol), args);
+}
+
 llvm::Value* JitNull(llvm::Module* M, llvm::IRBuilder<>& builder, const JitPoint& point)
 {
     return nullptr;
@@ -298,6 +524,11 @@ Jitter::Jitter()
     mPointProcessors.push_back({{"store",      CountValueValidator<2,2>},   WRAP(JitStore)});
     mPointProcessors.push_back({{"load",       CountValueValidator<1,1>},   WRAP(JitLoad)});
     mPointProcessors.push_back({{"tick",       MinCountValueValidator<0>},  WRAP(JitTick)});
+    mPointProcessors.push_back({{"rolling-sum",  RollingValidator},       WRAP(JitRolling)});
+    mPointProcessors.push_back({{"rolling-mean", RollingValidator},       WRAP(JitRolling)});
+    mPointProcessors.push_back({{"rolling-min",  RollingValidator},       WRAP(JitRolling)});
+    mPointProcessors.push_back({{"rolling-max",  RollingValidator},       WRAP(JitRolling)});
+    mProcessorIndex = IndexBySymbol(mPointProcessors);
 }
     //auto OwnerClone = std::unique_ptr<llvm::Module>(llvm::CloneModule(M));
 
@@ -314,6 +545,11 @@ std::string Jitter::GetDOTGraph() const
     return "digraph " + mGraph->GetDOTGraph();
 }
 
+std::string Jitter::GetDOTGraph(const std::vector<NodeProfile>& profile) const
+{
+    return "digraph " + mGraph->GetDOTGraph(profile);
+}
+
 llvm::Value* Jitter::JitNode(llvm::Module* M, llvm::IRBuilder<>&  builder, 
         const JitPoint& jp, llvm::Value* inputs, llvm::Value* observers)
 {
@@ -333,6 +569,10 @@ llvm::Value* Jitter::JitNode(llvm::Module* M, llvm::IRBuilder<>&  builder,
             std::make_pair(mNumStatePtr, jp.mNode->mInitValue));
         ret = JitGV(M, builder);
     }
+    else if((jp.mNode->mInputOffset >= 0) && mMultiInstance)
+    {
+        ret = builder.CreateLoad(JitColumn(builder, inputs, jp.mNode->mInputOffset));
+    }
     else if(jp.mNode->mInputOffset >= 0)
     {
         std::vector<llvm::Value*> gepIndex;
@@ -344,13 +584,11 @@ llvm::Value* Jitter::JitNode(llvm::Module* M, llvm::IRBuilder<>&  builder,
     }
     else if(jp.mNode->mKind == Node::KIND_PROC)
     {
-        for(auto& proc : mPointProcessors)
+        const auto symbol = jp.mNode->mSymbol;
+        if(symbol < mProcessorIndex.size() && mProcessorIndex[symbol] >= 0)
         {
-            if(jp.mNode->mToken.compare(proc.procedure.id) == 0)
-            {
-                assert(std::all_of(jp.mParents.begin(), jp.mParents.end(), [](JitPoint* p){return p->mValue != 0;}));
-                ret = proc.func(M, builder, jp);
-            }
+            assert(std::all_of(jp.mParents.begin(), jp.mParents.end(), [](JitPoint* p){return p->mValue != 0;}));
+            ret = mPointProcessors[mProcessorIndex[symbol]].func(M, builder, jp);
         }
     }
 
@@ -363,6 +601,13 @@ llvm::Value* Jitter::JitNode(llvm::Module* M, llvm::IRBuilder<>&  builder,
             ret = builder.CreateUIToFP(ret, builder.getDoubleTy());
         }
 
+        if(mMultiInstance)
+        {
+            // Columns have no dirty flags
+            builder.CreateStore(ret, JitColumn(builder, observers, jp.mNode->mObserverOffset));
+            return ret;
+        }
+
         std::vector<llvm::Value*> gepIndex;
         llvm::Value* nodeOffset = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*mLlvmContext), jp.mNode->mObserverOffset);
         gepIndex.push_back(nodeOffset);
@@ -379,11 +624,72 @@ llvm::Value* Jitter::JitNode(llvm::Module* M, llvm::IRBuilder<>&  builder,
     return ret;
 }
 
-static size_t FindNodeOffset(const std::vector<Node::Ptr>& nodes, Node::Ptr node)
+// Only procedures do any work worth counting
+llvm::Value* Jitter::JitProfiledNode(llvm::Module* M, llvm::IRBuilder<>&  builder, 
+        const JitPoint& jp, llvm::Value* inputs, llvm::Value* observers)
+{
+    if((mProfileMode == PROFILE_NONE) || (jp.mNode->mKind != Node::KIND_PROC))
+    {
+        return JitNode(M, builder, jp, inputs, observers);
+    }
+
+    auto slot = mProfileSlots.emplace(jp.mNode.get(), mProfileNodes.size());
+    if(slot.second) mProfileNodes.push_back(jp.mNode);
+    auto counter = [&](uint64_t field)
+    {
+        std::vector<llvm::Value*> gepIndex;
+        gepIndex.push_back(builder.getInt64(slot.first->second * PROFILE_FIELDS + field));
+        return builder.CreateGEP(mProfileCounters, gepIndex);
+    };
+
+    auto* readCycles = llvm::Intrinsic::getDeclaration(M, llvm::Intrinsic::readcyclecounter);
+    llvm::Value* start = nullptr;
+    if(mProfileMode == PROFILE_CYCLES)
+    {
+        start = builder.CreateCall(readCycles);
+    }
+
+    auto* ret = JitNode(M, builder, jp, inputs, observers);
+
+    builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, counter(0), builder.getInt64(1), llvm::Monotonic);
+    if(start)
+    {
+        auto* cycles = builder.CreateSub(builder.CreateCall(readCycles), start);
+        builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, counter(1), cycles, llvm::Monotonic);
+    }
+    return ret;
+}
+
+std::vector<std::string> GetHostCpuFeatures()
 {
-    auto foundNode = std::find(std::begin(nodes), std::end(nodes), node);
-    assert(foundNode != nodes.end() && "Could not find node");
-    return std::distance(nodes.begin(), foundNode);
+    std::vector<std::string> attrs;
+    llvm::StringMap<bool> features;
+    if(llvm::sys::getHostCPUFeatures(features))
+    {
+        for(const auto& feature : features)
+        {
+            attrs.push_back((feature.second ? "+" : "-") + feature.first().str());
+        }
+    }
+    return attrs;
+}
+
+void InitializeHostTarget()
+{
+    // Registering writes to llvm globals so only do it the once
+    static std::once_flag initialized;
+    std::call_once(initialized, []
+    {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+}
+
+static size_t FindNodeOffset(const LayoutOffsets& offsets, const Node::Ptr& node)
+{
+    auto foundNode = offsets.find(node.get());
+    assert(foundNode != offsets.end() && "Could not find node");
+    return foundNode->second;
 }
 
 struct CmpJitPointPtr
@@ -392,7 +698,8 @@ struct CmpJitPointPtr
     {
         const auto height = lhs->mNode->mHeight;
         const auto rhsHeight = rhs->mNode->mHeight;
-        return (height > rhsHeight) || ((height == rhsHeight) && (lhs > rhs));
+        // Points live in layout order so ties keep to the layout
+        return (height > rhsHeight) || ((height == rhsHeight) && (lhs < rhs));
     }
 };
 
@@ -422,7 +729,7 @@ llvm::PointerType* GetPointPointerType(llvm::Module* M)
     return llvm::PointerType::get(pointType, 0 /*address space*/);
 }
 
-std::unique_ptr<llvm::Module> Jitter::BuildModule()
+std::unique_ptr<llvm::Module> Jitter::BuildModule(JitObjectCache* cache)
 {    
     if(mLlvmContext)
     {
@@ -430,14 +737,36 @@ std::unique_ptr<llvm::Module> Jitter::BuildModule()
         return nullptr;
     }
 
-    auto sims = mGraph->SplitOutBy(Node::KIND_PROC, "sim-apply");
+    auto sims = mGraph->SplitOutBy(Node::KIND_PROC, SYMBOL_SIM_APPLY);
 
     // JIT IT BABY
-    mLlvmContext = new llvm::LLVMContext;
+    mLlvmContext.reset(new llvm::LLVMContext);
 
     auto module = std::unique_ptr<llvm::Module>(new llvm::Module("exys", *mLlvmContext));
     llvm::Module *M = module.get();
 
+    // The loop vectoriser needs to know what the target is capable of
+    std::unique_ptr<llvm::TargetMachine> hostMachine;
+    if(mMultiInstance)
+    {
+        mIncremental = false;
+        sims.clear();
+        hostMachine.reset(llvm::EngineBuilder()
+                            .setMCPU(llvm::sys::getHostCPUName())
+                            .setMAttrs(GetHostCpuFeatures())
+                            .selectTarget());
+        M->setDataLayout(hostMachine->createDataLayout());
+        M->setTargetTriple(hostMachine->getTargetTriple().str());
+    }
+
+    // Counters are written before we know how many nodes get one. Point
+    // them at a stand in and swap in the real buffer once we do
+    if(mProfileMode != PROFILE_NONE)
+    {
+        mProfileCounters = new llvm::GlobalVariable(*M, llvm::Type::getInt64Ty(*mLlvmContext), false,
+                llvm::GlobalValue::PrivateLinkage, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*mLlvmContext), 0));
+    }
+
     llvm::PointerType* pointerToPoint = GetPointPointerType(M);
     llvm::PointerType* pointerToDouble = llvm::PointerType::get(llvm::Type::getDoubleTy(M->getContext()), 0 /*address space*/);
 
@@ -447,22 +776,80 @@ std::unique_ptr<llvm::Module> Jitter::BuildModule()
     inoutargs.push_back(pointerToPoint);  // observers
     inoutargs.push_back(pointerToDouble); // state variables
   
-    auto stabFuncName = MangleName(STAB_FUNC_NAME, M->getDataLayout());
-    auto* stabilizeFunc =
-    llvm::cast<llvm::Function>(M->getOrInsertFunction(stabFuncName,
-                    llvm::FunctionType::get(
-                        llvm::Type::getVoidTy(*mLlvmContext), // void return
-                        inoutargs,
-                        false))); // no var args
-
-    llvm::Function::arg_iterator args = stabilizeFunc->arg_begin();
-    llvm::Value* inputsPtr = &(*args++);
-    llvm::Value* observersPtr = &(*args++);
-    llvm::Value* statePtr = &(*args++);
-
     auto nodeLayout = mGraph->GetLayout();
-    llvm::IRBuilder<> mainBuilder(BuildBlock(STAB_FUNC_NAME, nodeLayout, stabilizeFunc, M, inputsPtr, observersPtr, statePtr));
-    mainBuilder.CreateRetVoid();
+    llvm::Function* stabilizeFunc = nullptr;
+    if(mMultiInstance)
+    {
+        std::vector<llvm::Type*> multiargs;
+        multiargs.push_back(pointerToDouble); // input columns
+        multiargs.push_back(pointerToDouble); // observer columns
+        multiargs.push_back(pointerToDouble); // state columns
+        multiargs.push_back(llvm::Type::getInt64Ty(M->getContext())); // instance count
+
+        auto multiFuncName = MangleName(MULTI_STAB_FUNC_NAME, M->getDataLayout());
+        stabilizeFunc =
+        llvm::cast<llvm::Function>(M->getOrInsertFunction(multiFuncName,
+                        llvm::FunctionType::get(
+                            llvm::Type::getVoidTy(*mLlvmContext), // void return
+                            multiargs,
+                            false))); // no var args
+
+        // Saves the vectoriser checking the columns overlap at runtime
+        for(unsigned arg = 1; arg <= 3; ++arg)
+        {
+            stabilizeFunc->addAttribute(arg, llvm::Attribute::NoAlias);
+        }
+
+        llvm::Function::arg_iterator args = stabilizeFunc->arg_begin();
+        llvm::Value* inputsPtr = &(*args++);
+        llvm::Value* observersPtr = &(*args++);
+        llvm::Value* statePtr = &(*args++);
+        mInstanceCount = &(*args++);
+
+        auto* entry = llvm::BasicBlock::Create(*mLlvmContext, "entry", stabilizeFunc);
+        auto* header = llvm::BasicBlock::Create(*mLlvmContext, "instance", stabilizeFunc);
+        llvm::IRBuilder<> multiBuilder(entry);
+        auto* zero = multiBuilder.getInt64(0);
+        auto* exit = llvm::BasicBlock::Create(*mLlvmContext, "instance-end", stabilizeFunc);
+        multiBuilder.CreateCondBr(multiBuilder.CreateICmpSGT(mInstanceCount, zero), header, exit);
+
+        multiBuilder.SetInsertPoint(header);
+        auto* index = multiBuilder.CreatePHI(multiBuilder.getInt64Ty(), 2);
+        index->addIncoming(zero, entry);
+        mInstanceIndex = index;
+
+        // Not incremental so the body is a single block
+        auto* body = BuildBlock(MULTI_STAB_FUNC_NAME, nodeLayout, stabilizeFunc, M, inputsPtr, observersPtr, statePtr);
+        multiBuilder.CreateBr(body);
+
+        multiBuilder.SetInsertPoint(body);
+        auto* next = multiBuilder.CreateAdd(index, multiBuilder.getInt64(1));
+        index->addIncoming(next, body);
+        multiBuilder.CreateCondBr(multiBuilder.CreateICmpSLT(next, mInstanceCount), header, exit);
+
+        exit->moveAfter(body);
+        multiBuilder.SetInsertPoint(exit);
+        multiBuilder.CreateRetVoid();
+    }
+    else
+    {
+        auto stabFuncName = MangleName(STAB_FUNC_NAME, M->getDataLayout());
+        stabilizeFunc =
+        llvm::cast<llvm::Function>(M->getOrInsertFunction(stabFuncName,
+                        llvm::FunctionType::get(
+                            llvm::Type::getVoidTy(*mLlvmContext), // void return
+                            inoutargs,
+                            false))); // no var args
+
+        llvm::Function::arg_iterator args = stabilizeFunc->arg_begin();
+        llvm::Value* inputsPtr = &(*args++);
+        llvm::Value* observersPtr = &(*args++);
+        llvm::Value* statePtr = &(*args++);
+
+        llvm::IRBuilder<> mainBuilder(BuildBlock(STAB_FUNC_NAME, nodeLayout, stabilizeFunc, M, inputsPtr, observersPtr, statePtr,
+                    true, mIncremental));
+        mainBuilder.CreateRetVoid();
+    }
 
     // Record inputs and outputs
     for(auto node : nodeLayout)
@@ -551,9 +938,56 @@ std::unique_ptr<llvm::Module> Jitter::BuildModule()
     }
     initBuilder.CreateRetVoid();
 
-    // Optimisation passes
-    llvm::legacy::PassManager *PM2 = new llvm::legacy::PassManager();
-    llvm::legacy::FunctionPassManager *FM = new llvm::legacy::FunctionPassManager(module.get());
+    if(mProfileCounters)
+    {
+        auto* countersType = llvm::ArrayType::get(llvm::Type::getInt64Ty(*mLlvmContext),
+                mProfileNodes.size() * PROFILE_FIELDS);
+        auto* counters = new llvm::GlobalVariable(*M, countersType, false, llvm::GlobalValue::ExternalLinkage,
+                llvm::ConstantAggregateZero::get(countersType), MangleName(PROFILE_NAME, M->getDataLayout()));
+        mProfileCounters->replaceAllUsesWith(llvm::ConstantExpr::getBitCast(counters, mProfileCounters->getType()));
+        mProfileCounters->eraseFromParent();
+        mProfileCounters = nullptr;
+    }
+
+    mGraph->ReleaseBuildState();
+
+    // Objects in the cache are already optimised and compiled so
+    // all the execution engine needs is the key to load them by
+    bool cached = false;
+    if(cache)
+    {
+        const auto key = JitObjectCache::GetModuleKey(*M);
+        M->setModuleIdentifier(key);
+        cached = cache->HasObject(key);
+    }
+    if(!cached)
+    {
+        OptimiseModule(M, hostMachine.get());
+    }
+
+    // Output asm
+    std::string out;
+    llvm::raw_string_ostream rawout(out);
+    if(llvm::verifyModule(*M, &rawout))
+    {
+        rawout << *stabilizeFunc;
+        rawout << *simFunc;
+        rawout << *initFunc;
+        throw GraphBuildException(rawout.str(), Cell());
+    }
+    return module;
+}
+
+void Jitter::OptimiseModule(llvm::Module* M, llvm::TargetMachine* hostMachine)
+{
+    llvm::legacy::PassManager PM2;
+    llvm::legacy::FunctionPassManager FM(M);
+
+    if(hostMachine)
+    {
+        PM2.add(llvm::createTargetTransformInfoWrapperPass(hostMachine->getTargetIRAnalysis()));
+        FM.add(llvm::createTargetTransformInfoWrapperPass(hostMachine->getTargetIRAnalysis()));
+    }
 
     llvm::PassManagerBuilder PMB;
     PMB.OptLevel = 3;
@@ -571,47 +1005,36 @@ std::unique_ptr<llvm::Module> Jitter::BuildModule()
     PMB.MergeFunctions = true;
     PMB.PrepareForLTO = false;
     PMB.Inliner = llvm::createFunctionInliningPass();
-    PMB.populateModulePassManager(*PM2);
-    PMB.populateFunctionPassManager(*FM);
+    PMB.populateModulePassManager(PM2);
+    PMB.populateFunctionPassManager(FM);
 
     //llvm::DebugFlag=true;
-    FM->doInitialization();
-    for (llvm::Function &F : *module.get()) 
+    FM.doInitialization();
+    for (llvm::Function &F : *M) 
     {
-        FM->run(F);
+        FM.run(F);
     }
-    FM->doFinalization();
-    PM2->run(*module.get());
- 
-    // Output asm
-    std::string out;
-    llvm::raw_string_ostream rawout(out);
-    if(llvm::verifyModule(*M, &rawout))
-    {
-        rawout << *stabilizeFunc;
-        rawout << *simFunc;
-        rawout << *initFunc;
-        throw GraphBuildException(rawout.str(), Cell());
-    }
-    return module;
+    FM.doFinalization();
+    PM2.run(*M);
 }
 
 llvm::BasicBlock* Jitter::BuildBlock(const std::string& blockName, const std::vector<Node::Ptr>& nodeLayout, 
         llvm::Function* func, llvm::Module *M, llvm::Value* inputsPtr, llvm::Value* observersPtr, llvm::Value* statePtr,
-        bool ret)
+        bool ret, bool incremental)
 {
     std::vector<JitPoint> jitPoints;
     jitPoints.resize(nodeLayout.size());
+    const auto layoutOffsets = GetLayoutOffsets(nodeLayout);
 
-    for(auto node : nodeLayout)
+    for(size_t offset = 0; offset < nodeLayout.size(); ++offset)
     {
-        size_t offset = FindNodeOffset(nodeLayout, node);
+        const auto& node = nodeLayout[offset];
         auto& jp = jitPoints[offset];
         jp.mNode = node;
 
         for(auto pnode : node->mParents)
         {
-            auto& parent = jitPoints[FindNodeOffset(nodeLayout, pnode)];
+            auto& parent = jitPoints[FindNodeOffset(layoutOffsets, pnode)];
             jp.mParents.push_back(&parent);
             parent.mChildren.push_back(&jp);
         }
@@ -629,13 +1052,221 @@ llvm::BasicBlock* Jitter::BuildBlock(const std::string& blockName, const std::ve
         assert(jp.mNode);
         jitHeap.insert(&jp);
     }
-    for(auto& jp : jitHeap)
+
+    if(incremental)
+    {
+        std::vector<JitPoint*> ordered(jitHeap.begin(), jitHeap.end());
+        block = BuildIncrementalBlock(block, ordered, func, M, inputsPtr, observersPtr);
+    }
+    else
     {
-        const_cast<JitPoint*>(jp)->mValue = JitNode(M, builder, *jp, inputsPtr, observersPtr);
+        for(auto& jp : jitHeap)
+        {
+            const_cast<JitPoint*>(jp)->mValue = JitProfiledNode(M, builder, *jp, inputsPtr, observersPtr);
+        }
     }
 
+    mStateSpaceSize = std::max(mStateSpaceSize, mNumStatePtr);
     return block;
 }
+
+static bool IsStatefulNode(const Node::Ptr& node)
+{
+    if(node->mKind == Node::KIND_VAR) return true;
+    if(node->mKind != Node::KIND_PROC) return false;
+    switch(node->mSymbol)
+    {
+        case SYMBOL_TICK:
+        case SYMBOL_ROLLING_SUM:
+        case SYMBOL_ROLLING_MEAN:
+        case SYMBOL_ROLLING_MIN:
+        case SYMBOL_ROLLING_MAX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Nodes are grouped by the set of inputs they depend on and each group
+// is guarded by a check of those inputs dirty flags. Anything touching
+// state, or depending on too many inputs to be worth guarding, runs every
+// time. Values crossing a group boundary are cached in the state buffer
+// so a skipped group still provides its last result.
+llvm::BasicBlock* Jitter::BuildIncrementalBlock(llvm::BasicBlock* entry, const std::vector<JitPoint*>& jitPoints,
+        llvm::Function* func, llvm::Module *M, llvm::Value* inputsPtr, llvm::Value* observersPtr)
+{
+    // Past this the checks cost more than they save and the amount of
+    // branching starts to hurt the optimiser
+    constexpr size_t MAX_GROUP_SOURCES = 16;
+
+    // Collect the sources for each node - parents come first in the heap order.
+    // Wide or stateful nodes are always computed so stop tracking them
+    struct Sources
+    {
+        std::vector<uint32_t> mInputs;
+        bool mAlways = false;
+    };
+    std::unordered_map<const JitPoint*, Sources> sources;
+    for(auto* jp : jitPoints)
+    {
+        auto& src = sources[jp];
+        src.mAlways = IsStatefulNode(jp->mNode);
+        if(jp->mNode->mInputOffset >= 0) src.mInputs.push_back(jp->mNode->mInputOffset);
+        for(auto* parent : jp->mParents)
+        {
+            const auto& psrc = sources[parent];
+            src.mAlways |= psrc.mAlways;
+            if(src.mAlways) break;
+            src.mInputs.insert(src.mInputs.end(), psrc.mInputs.begin(), psrc.mInputs.end());
+        }
+        std::sort(src.mInputs.begin(), src.mInputs.end());
+        src.mInputs.erase(std::unique(src.mInputs.begin(), src.mInputs.end()), src.mInputs.end());
+        if(src.mAlways || (src.mInputs.size() > MAX_GROUP_SOURCES))
+        {
+            src.mAlways = true;
+            src.mInputs.clear();
+        }
+    }
+
+    // A node's sources are a superset of its parents so ordering groups
+    // by source count keeps them topologically sorted. Nothing guarded
+    // can depend on an always computed node so those go last in heap order
+    std::map<std::vector<uint32_t>, std::vector<JitPoint*>> groupMap;
+    std::vector<JitPoint*> always;
+    for(auto* jp : jitPoints)
+    {
+        if(jp->mNode->mInputOffset >= 0) continue; // loaded where used
+        const auto& src = sources[jp];
+        if(src.mAlways) always.push_back(jp);
+        else groupMap[src.mInputs].push_back(jp);
+    }
+    std::vector<std::pair<std::vector<uint32_t>, std::vector<JitPoint*>>> groups(groupMap.begin(), groupMap.end());
+    std::stable_sort(groups.begin(), groups.end(), 
+        [](const std::pair<std::vector<uint32_t>, std::vector<JitPoint*>>& lhs,
+           const std::pair<std::vector<uint32_t>, std::vector<JitPoint*>>& rhs)
+        {
+            return lhs.first.size() < rhs.first.size();
+        });
+    groups.emplace_back(std::vector<uint32_t>(), std::move(always));
+
+    std::unordered_map<const JitPoint*, size_t> groupOf;
+    for(size_t g = 0; g < groups.size(); ++g)
+    {
+        for(auto* jp : groups[g].second) groupOf[jp] = g;
+    }
+
+    // Only values read from another group need somewhere to live
+    std::unordered_map<const JitPoint*, int> cacheSlots;
+    for(size_t g = 0; g < groups.size(); ++g)
+    {
+        if(groups[g].first.empty()) continue;
+        for(auto* jp : groups[g].second)
+        {
+            for(auto* child : jp->mChildren)
+            {
+                if(groupOf[child] != g)
+                {
+                    cacheSlots.emplace(jp, cacheSlots.size());
+                    break;
+                }
+            }
+        }
+    }
+
+    llvm::IRBuilder<> builder(entry);
+    llvm::Value* dirtyIndex = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*mLlvmContext), 2);
+    llvm::Value* clean = llvm::ConstantInt::get(llvm::Type::getInt8Ty(*mLlvmContext), 0);
+
+    // Read every flag up front so the checks don't sit between cache stores
+    std::map<uint32_t, llvm::Value*> dirtyFlags;
+    for(const auto& group : groups)
+    {
+        for(auto offset : group.first)
+        {
+            if(dirtyFlags.count(offset)) continue;
+            std::vector<llvm::Value*> gepIndex;
+            gepIndex.push_back(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*mLlvmContext), offset));
+            gepIndex.push_back(dirtyIndex);
+            auto* flag = builder.CreateLoad(builder.CreateGEP(inputsPtr, gepIndex));
+            dirtyFlags[offset] = builder.CreateICmpNE(flag, clean);
+        }
+    }
+
+    // Cache sits after the rest of the state. The offset
+    // is patched in once we know how much state there is
+    std::vector<llvm::Value*> baseIndex;
+    baseIndex.push_back(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*mLlvmContext), 0));
+    auto* cacheBase = llvm::cast<llvm::Instruction>(builder.CreateGEP(mStatePtr, baseIndex));
+    auto cacheSlot = [&](int slot)
+    {
+        std::vector<llvm::Value*> gepIndex;
+        gepIndex.push_back(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*mLlvmContext), slot));
+        return builder.CreateGEP(cacheBase, gepIndex);
+    };
+
+    for(size_t g = 0; g < groups.size(); ++g)
+    {
+        const auto& src = groups[g].first;
+        llvm::BasicBlock* groupEnd = nullptr;
+        if(!src.empty())
+        {
+            llvm::Value* dirty = nullptr;
+            for(auto offset : src)
+            {
+                dirty = dirty ? builder.CreateOr(dirty, dirtyFlags[offset]) : dirtyFlags[offset];
+            }
+            auto* groupBody = llvm::BasicBlock::Create(*mLlvmContext, "group", func);
+            groupEnd = llvm::BasicBlock::Create(*mLlvmContext, "group-end", func);
+            builder.CreateCondBr(dirty, groupBody, groupEnd);
+            builder.SetInsertPoint(groupBody);
+        }
+
+        std::unordered_map<const JitPoint*, llvm::Value*> reloaded;
+        for(auto* jp : groups[g].second)
+        {
+            for(auto* parent : jp->mParents)
+            {
+                const bool isInput = parent->mNode->mInputOffset >= 0;
+                const bool isCached = cacheSlots.count(parent) && (groupOf[parent] != g);
+                if(!isInput && !isCached) continue;
+
+                auto riter = reloaded.find(parent);
+                if(riter == reloaded.end())
+                {
+                    llvm::Value* val = isInput ? 
+                        JitNode(M, builder, *parent, inputsPtr, observersPtr) :
+                        builder.CreateLoad(cacheSlot(cacheSlots[parent]));
+                    riter = reloaded.emplace(parent, val).first;
+                }
+                parent->mValue = riter->second;
+            }
+
+            jp->mValue = JitProfiledNode(M, builder, *jp, inputsPtr, observersPtr);
+
+            auto siter = cacheSlots.find(jp);
+            if(siter != cacheSlots.end())
+            {
+                llvm::Value* val = jp->mValue;
+                if(val->getType() != builder.getDoubleTy())
+                {
+                    val = builder.CreateUIToFP(val, builder.getDoubleTy());
+                }
+                builder.CreateStore(val, cacheSlot(siter->second));
+            }
+        }
+
+        if(groupEnd)
+        {
+            builder.CreateBr(groupEnd);
+            builder.SetInsertPoint(groupEnd);
+        }
+    }
+
+    cacheBase->setOperand(1, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*mLlvmContext), mNumStatePtr));
+    mNumStatePtr += cacheSlots.size();
+
+    return builder.GetInsertBlock();
+}
     
 std::unique_ptr<Graph> Jitter::BuildAndLoadGraph()
 {
@@ -657,6 +1288,7 @@ std::unique_ptr<Jitter> Jitter::Build(const std::string& text)
     auto graph = jitter->BuildAndLoadGraph();
 
     graph->Construct(Parse(text));
+    graph->Optimise();
     jitter->AssignGraph(graph);
     return jitter;
 }
@@ -11,6 +11,7 @@
 #include "llvm/IR/Module.h"
 
 #include "exys.h"
+#include "pointengine.h"
 
 namespace llvm
 {
@@ -19,24 +20,27 @@ namespace llvm
     class ExecutionEngine;
     class Function;
     class Block;
+    class TargetMachine;
+    class GlobalVariable;
 };
 
 namespace 
 {
     const std::string INIT_FUNC_NAME = "ExysInit";
     const std::string STAB_FUNC_NAME = "ExysStabilize";
+    const std::string MULTI_STAB_FUNC_NAME = "ExysStabilizeMulti";
     const std::string SIM_FUNC_NAME  = "ExysSim";
     const std::string POINT_NAME     = "Point";
+    const std::string PROFILE_NAME   = "ExysProfile";
 };
 
 namespace Exys
 {
 
-typedef void (*InitFunc)(double* state);
-typedef void (*StabilizationFunc)(Point* inputs, Point* observers, double* state);
-typedef void (*SimFunc)(Point* inputs, Point* inputsAndDone, double* state, int simId);
+typedef void (*MultiStabilizationFunc)(double* inputs, double* observers, double* state, int64_t count);
 
 class JitPoint;
+class JitObjectCache;
 
 struct JitPointDescription
 {
@@ -53,6 +57,13 @@ struct JitPointProcessor
     JitComputeFunction func; 
 };
 
+// Target features of the cpu we are running on so modules can be
+// optimised and code generated for its vector units
+std::vector<std::string> GetHostCpuFeatures();
+
+// Registers the host target with llvm. Safe to call from any thread
+void InitializeHostTarget();
+
 class Jitter
 {
 public:
@@ -63,23 +74,62 @@ public:
     
     const std::vector<Node::Ptr>& GetInputDesc() const { return mInputs; }
     const std::vector<Node::Ptr>& GetObserverDesc() const { return mObservers; }
-    int GetStateSpaceSize() const { return mNumStatePtr; }
+    int GetStateSpaceSize() const { return mStateSpaceSize; }
     int GetSimFuncCount() const { return mNumSimFunc; }
     const std::vector<std::string>& GetSimFuncTargets() const { return mSimTargets; }
 
-    std::unique_ptr<llvm::Module> BuildModule();
+    // Incremental modules only recompute nodes downstream of dirty
+    // inputs. Callers must set the dirty flag on inputs they change.
+    void SetIncremental(bool incremental) { mIncremental = incremental; }
+
+    // Multi instance modules stabilize count copies of the graph in one
+    // call. Every input, observer and state slot is a column holding one
+    // double per instance so the loop over instances vectorises.
+    // Replaces the single stabilize function and has no simulations.
+    void SetMultiInstance(bool multiInstance) { mMultiInstance = multiInstance; }
+
+    // Profiled modules bump a pair of counters for every procedure they
+    // compute: the evaluation count then, with PROFILE_CYCLES, the cycles
+    // between stamps taken either side of it. The counters are atomic so
+    // engines sharing the code on other threads can run at the same time.
+    // They live in the PROFILE_NAME global of the module in the order of
+    // GetProfileNodes
+    enum ProfileMode
+    {
+        PROFILE_NONE,
+        PROFILE_COUNTS,
+        PROFILE_CYCLES
+    };
+    static constexpr int PROFILE_FIELDS = 2;
+    void SetProfileMode(ProfileMode mode) { mProfileMode = mode; }
+    ProfileMode GetProfileMode() const { return mProfileMode; }
+    const std::vector<Node::Ptr>& GetProfileNodes() const { return mProfileNodes; }
+
+    // With a cache the optimisation passes are skipped when it already
+    // holds the compiled module. Give the execution engine the same cache
+    std::unique_ptr<llvm::Module> BuildModule(JitObjectCache* cache=nullptr);
 
     std::string GetDOTGraph() const;
+    std::string GetDOTGraph(const std::vector<NodeProfile>& profile) const;
 private:
     void AssignGraph(std::unique_ptr<Graph>& graph);
     std::unique_ptr<Graph> BuildAndLoadGraph();
 
-    // def memleaks here but llvm doesnt doc how to pull down
-    // the exec engine and the examples I've hit segfaults
-    llvm::LLVMContext* mLlvmContext = nullptr;
+    // Everything in the module lives in here so any execution
+    // engine running the module must be destroyed first
+    std::unique_ptr<llvm::LLVMContext> mLlvmContext;
     llvm::Value* mStatePtr = nullptr;
     int mNumStatePtr = 0;
+    int mStateSpaceSize = 0;
     int mNumSimFunc = 0;
+    bool mIncremental = true;
+    bool mMultiInstance = false;
+    llvm::Value* mInstanceCount = nullptr;
+    llvm::Value* mInstanceIndex = nullptr;
+    ProfileMode mProfileMode = PROFILE_NONE;
+    llvm::GlobalVariable* mProfileCounters = nullptr;
+    std::unordered_map<const Node*, uint64_t> mProfileSlots;
+    std::vector<Node::Ptr> mProfileNodes;
     std::vector<std::string> mSimTargets;
     
     std::vector<Node::Ptr> mInputs;
@@ -88,19 +138,27 @@ private:
 
     std::unique_ptr<Graph> mGraph;
     std::vector<JitPointProcessor> mPointProcessors;
+    std::vector<int> mProcessorIndex;
 
     // LLVM helpers
+    void OptimiseModule(llvm::Module* M, llvm::TargetMachine* hostMachine);
     llvm::BasicBlock* BuildBlock(const std::string& blockName, const std::vector<Node::Ptr>& nodeLayout, 
             llvm::Function* func, llvm::Module *M, llvm::Value* inputsPtr, llvm::Value* observersPtr, llvm::Value* statePtr,
-            bool ret=true);
+            bool ret=true, bool incremental=false);
+    llvm::BasicBlock* BuildIncrementalBlock(llvm::BasicBlock* entry, const std::vector<JitPoint*>& jitPoints,
+            llvm::Function* func, llvm::Module *M, llvm::Value* inputsPtr, llvm::Value* observersPtr);
     llvm::Value* JitGV(llvm::Module* M, llvm::IRBuilder<>& builder);
+    llvm::Value* JitColumn(llvm::IRBuilder<>& builder, llvm::Value* base, uint64_t column);
     llvm::Value* JitNode(llvm::Module* M, llvm::IRBuilder<>&  builder, 
         const JitPoint& jp, llvm::Value* inputs, llvm::Value* observers);
+    llvm::Value* JitProfiledNode(llvm::Module* M, llvm::IRBuilder<>&  builder, 
+        const JitPoint& jp, llvm::Value* inputs, llvm::Value* observers);
     llvm::Value* JitLatch(llvm::Module*, llvm::IRBuilder<>&, const JitPoint&);
     llvm::Value* JitFlipFlop(llvm::Module*, llvm::IRBuilder<>&, const JitPoint&);
     llvm::Value* JitStore(llvm::Module*, llvm::IRBuilder<>&, const JitPoint&);
     llvm::Value* JitLoad(llvm::Module*, llvm::IRBuilder<>&, const JitPoint&);
     llvm::Value* JitTick(llvm::Module*, llvm::IRBuilder<>&, const JitPoint&);
+    llvm::Value* JitRolling(llvm::Module*, llvm::IRBuilder<>&, const JitPoint&);
 };
 
 };
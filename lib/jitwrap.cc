@@ -3,44 +3,45 @@
 #include <iostream>
 #include <sstream>
 #include <cassert>
+#include <cstdlib>
+#include <algorithm>
 
 #include "llvm/ExecutionEngine/MCJIT.h"
 
 #include "jitwrap.h"
-#include "helpers.h"
+
+namespace
+{
+    constexpr char EXYS_JIT_PROFILE[] = "EXYS_JIT_PROFILE";
+}
 
 namespace Exys
 {
 
+JitCode::~JitCode()
+{
+}
+
 JitWrap::JitWrap(std::unique_ptr<Jitter> jitter)
-: mJitter(std::move(jitter))
+: mCode(std::make_shared<JitCode>())
 {
+    mCode->mJitter = std::move(jitter);
 }
 
 // Use this constructor if you want run the simulations
 // against a second memory location i.e. in a thread
 JitWrap::JitWrap(JitWrap& jw)
-: mRawStabilizeFunc(jw.mRawStabilizeFunc)
-, mRawSimFunc(jw.mRawSimFunc)
-, mSimFuncCount(jw.mSimFuncCount)
-, mSimFuncTargets(jw.mSimFuncTargets)
-, mState(jw.mState)
-, mPoints(jw.mPoints)
-, mInputSize(jw.mInputSize)
-, mObserverOffsets(jw.mObserverOffsets)
-, mInputOffsets(jw.mInputOffsets)
+: CompiledEngine(jw)
+, mCode(jw.mCode)
 {
-    SetPointPtrs();
 }
 
 // Copy to capture so calling convention is simplified slightly
 // where you can always call reset before a simulation
 void JitWrap::CopyState(JitWrap& jw)
 {
-    std::copy(jw.mState.begin(), jw.mState.end(),
-        std::back_inserter(mStateCapture));
-    std::copy(jw.mPoints.begin(), jw.mPoints.end(),
-        std::back_inserter(mPointsCapture));
+    mStateCapture = jw.mState;
+    mPointsCapture = jw.mPoints;
     SetPointPtrs();
 }
 
@@ -50,47 +51,57 @@ JitWrap::~JitWrap()
 
 std::string JitWrap::GetDOTGraph() const
 {
-    if(mJitter) return mJitter->GetDOTGraph();
+    if(mCode && mCode->mJitter) return mCode->mJitter->GetDOTGraph();
     return "";
 }
 
 void JitWrap::BuildJitEngine(std::unique_ptr<llvm::Module> module)
 {
     std::string error;
-    auto* llvmExecEngine = llvm::EngineBuilder(std::move(module))
+    mCode->mExecEngine.reset(llvm::EngineBuilder(std::move(module))
                                 .setEngineKind(llvm::EngineKind::JIT)
                                 .setOptLevel(llvm::CodeGenOpt::Level::Aggressive)
                                 .setErrorStr(&error)
-                                .create();
-    llvmExecEngine->DisableGVCompilation(true);
+                                .create());
+    auto* llvmExecEngine = mCode->mExecEngine.get();
     if(!llvmExecEngine)
     {
         // throw here
         std::cout << error;
         assert(llvmExecEngine);
     }
+    if(mCode->mObjectCache)
+    {
+        llvmExecEngine->setObjectCache(mCode->mObjectCache.get());
+    }
+    llvmExecEngine->DisableGVCompilation(true);
 
     mRawStabilizeFunc = reinterpret_cast<StabilizationFunc>(llvmExecEngine->getPointerToNamedFunction(STAB_FUNC_NAME));
     mInitFunc = reinterpret_cast<InitFunc>(llvmExecEngine->getPointerToNamedFunction(INIT_FUNC_NAME));
-    if(mJitter->GetSimFuncCount() > 0)
+    if(mCode->mJitter->GetSimFuncCount() > 0)
     {
         mRawSimFunc = reinterpret_cast<SimFunc>(llvmExecEngine->getPointerToNamedFunction(SIM_FUNC_NAME));
     }
 
     llvmExecEngine->finalizeObject();
+    if(mCode->mJitter->GetProfileMode() != Jitter::PROFILE_NONE)
+    {
+        mCode->mProfileCounters = reinterpret_cast<uint64_t*>(llvmExecEngine->getGlobalValueAddress(PROFILE_NAME));
+        assert(mCode->mProfileCounters);
+    }
     
     // Setup memory
-    const auto& inputDesc = mJitter->GetInputDesc();
-    const auto& observerDesc = mJitter->GetObserverDesc();
+    const auto& inputDesc = mCode->mJitter->GetInputDesc();
+    const auto& observerDesc = mCode->mJitter->GetObserverDesc();
     mPoints.resize(inputDesc.size() + observerDesc.size());
-    mState.resize(mJitter->GetStateSpaceSize());
+    mState.resize(mCode->mJitter->GetStateSpaceSize());
 
     for(const auto& id : inputDesc)
     {
         for(const auto& label : id->mInputLabels)
         {
             assert(id->mInputOffset < (int)inputDesc.size());
-            mInputOffsets[label] = id->mInputOffset;
+            mLabels->mInputOffsets[label] = id->mInputOffset;
             auto& ip = mPoints[id->mInputOffset];
             ip.mLength = id->mLength;
         }
@@ -101,167 +112,113 @@ void JitWrap::BuildJitEngine(std::unique_ptr<llvm::Module> module)
         {
             int obOffset = inputDesc.size()+od->mObserverOffset;
             assert(obOffset < (int)mPoints.size());
-            mObserverOffsets[label] = obOffset;
+            mLabels->mObserverOffsets[label] = obOffset;
             auto& op = mPoints[obOffset];
             op.mLength = od->mLength;
         }
     }
     mInputSize = inputDesc.size();
+    mBatchStamps.resize(mInputSize);
     mInitFunc(mState.data());
     SetPointPtrs();
     // we shift the observers by one so we can fit done flag
     // at the end
 }
 
-void JitWrap::SetPointPtrs()
-{
-    mInputPtr = &mPoints.front();
-    mObserverPtr = &mPoints.front() + mInputSize;
-}
-
 void JitWrap::CompleteBuild()
 {
-    assert(mJitter && "Can only build with underlying jitter");
-    LLVMInitializeNativeTarget();
-    LLVMInitializeNativeAsmPrinter();
+    assert(mCode->mJitter && "Can only build with underlying jitter");
+    InitializeHostTarget();
     
-    BuildJitEngine(mJitter->BuildModule());
-
-    mSimFuncCount = mJitter->GetSimFuncCount();
-    mSimFuncTargets = mJitter->GetSimFuncTargets();
-
-    Stabilize(true);
-}
-
-bool JitWrap::IsDirty() const
-{
-    for(const auto& namep : mInputOffsets)
+    auto& jitter = mCode->mJitter;
+    const char* profile = getenv(EXYS_JIT_PROFILE);
+    if((jitter->GetProfileMode() == Jitter::PROFILE_NONE) && profile && *profile)
     {
-        const auto& point = mPoints[namep.second];
-        if(point.IsDirty()) return true;
+        jitter->SetProfileMode(std::string(profile) == "counts" ?
+                Jitter::PROFILE_COUNTS : Jitter::PROFILE_CYCLES);
     }
-    return false;
-}
 
-void JitWrap::Stabilize(bool force)
-{
-    if(force || mJitter->GetStateSpaceSize() || IsDirty())
-    {
-        mRawStabilizeFunc(mInputPtr, mObserverPtr, mState.data());
-        for(auto& p : mPoints) p.Clean();
-    }
-}
+    auto& cache = mCode->mObjectCache;
+    if(!cache) cache = JitObjectCache::FromEnvironment();
+    BuildJitEngine(mCode->mJitter->BuildModule(cache.get()));
 
-bool JitWrap::HasInputPoint(const std::string& label) const
-{
-    auto niter = mInputOffsets.find(label);
-    return niter != mInputOffsets.end();
-}
+    mSimFuncCount = mCode->mJitter->GetSimFuncCount();
+    mCode->mSimFuncTargets = mCode->mJitter->GetSimFuncTargets();
 
-Point& JitWrap::LookupInputPoint(const std::string& label)
-{
-    assert(HasInputPoint(label));
-    auto niter = mInputOffsets.find(label);
-    return mPoints[niter->second];
+    Stabilize(true);
+    ResetProfile();
 }
 
-std::vector<std::string> JitWrap::GetInputPointLabels() const
+std::string JitWrap::GetNumSimulationTarget(int simId) const
 {
-    std::vector<std::string> ret;
-    for(const auto& ip : mInputOffsets)
+    assert(simId >= (int)mCode->mSimFuncTargets.size() && "simid index out of range");
+    if(simId < (int)mCode->mSimFuncTargets.size())
     {
-        ret.push_back(ip.first);
+        return mCode->mSimFuncTargets[simId];
     }
-    return ret;
-}
 
-std::vector<std::pair<std::string, double>> JitWrap::DumpInputs() const
-{
-    std::vector<std::pair<std::string, double>> ret;
-    for(const auto& ip : mInputOffsets)
-    {
-        ret.push_back(std::make_pair(ip.first, mPoints[ip.second].mVal));
-    }
-    return ret;
+    return "";
 }
 
-bool JitWrap::HasObserverPoint(const std::string& label) const
+std::unique_ptr<IEngine> JitWrap::Build(const std::string& text)
 {
-    auto niter = mObserverOffsets.find(label);
-    return niter != mObserverOffsets.end();
+    auto jitter = Jitter::Build(text);
+    auto engine = std::unique_ptr<JitWrap>(new JitWrap(std::move(jitter)));
+    engine->CompleteBuild();
+    return std::unique_ptr<IEngine>(std::move(engine));
 }
 
-Point& JitWrap::LookupObserverPoint(const std::string& label)
+std::vector<NodeProfile> JitWrap::GetProfile() const
 {
-    assert(HasObserverPoint(label));
-    auto niter = mObserverOffsets.find(label);
-    return mPoints[niter->second];
-}
+    std::vector<NodeProfile> ret;
+    if(!mCode->mProfileCounters) return ret;
 
-std::vector<std::string> JitWrap::GetObserverPointLabels() const
-{
-    std::vector<std::string> ret;
-    for(const auto& ip : mObserverOffsets)
+    const auto& nodes = mCode->mJitter->GetProfileNodes();
+    for(size_t i = 0; i < nodes.size(); ++i)
     {
-        ret.push_back(ip.first);
-    }
-    return ret;
-}
+        const auto* counters = mCode->mProfileCounters + i * Jitter::PROFILE_FIELDS;
+        if(!counters[0]) continue;
 
-std::vector<std::pair<std::string, double>> JitWrap::DumpObservers() const
-{
-    std::vector<std::pair<std::string, double>> ret;
-    for(const auto& ip : mObserverOffsets)
-    {
-        ret.push_back(std::make_pair(ip.first, mPoints[ip.second].mVal));
+        auto np = GetNodeProfile(nodes[i]);
+        np.mEvaluations = counters[0];
+        np.mCycles = counters[1];
+        ret.push_back(np);
     }
+    SortProfile(ret);
     return ret;
 }
 
-bool JitWrap::SupportSimulation() const
+void JitWrap::ResetProfile()
 {
-    return true;
+    if(!mCode->mProfileCounters) return;
+    const auto size = mCode->mJitter->GetProfileNodes().size() * Jitter::PROFILE_FIELDS;
+    std::fill(mCode->mProfileCounters, mCode->mProfileCounters + size, 0);
 }
 
-int JitWrap::GetNumSimulationFunctions() const
+// Generated code doesn't know if a value changed so there's no waste
+std::string JitWrap::GetProfileReport() const
 {
-    return mSimFuncCount;
+    return FormatProfileReport(GetProfile(), false);
 }
 
-void JitWrap::CaptureState()
+std::string JitWrap::GetProfileDOTGraph() const
 {
-    mPointsCapture = mPoints;
-    mStateCapture = mState;
+    return mCode->mJitter->GetDOTGraph(GetProfile());
 }
 
-void JitWrap::ResetState()
+std::unique_ptr<IEngine> JitWrap::Build(const std::string& text, const std::string& cacheDirectory)
 {
-    mPoints = mPointsCapture;
-    mState = mStateCapture;
-}
-
-bool JitWrap::RunSimulationId(int simId)
-{
-    assert(mRawSimFunc && "Simulation function does not exist");
-    if(!mRawSimFunc) return true;
-    mRawSimFunc(mInputPtr, mInputPtr, mState.data(), simId);
-    return mInputPtr[mInputSize] != 0.0;
-}
-
-std::string JitWrap::GetNumSimulationTarget(int simId) const
-{
-    assert(simId >= (int)mSimFuncTargets.size() && "simid index out of range");
-    if(simId < (int)mSimFuncTargets.size())
-    {
-        return mSimFuncTargets[simId];
-    }
-
-    return "";
+    auto jitter = Jitter::Build(text);
+    auto engine = std::unique_ptr<JitWrap>(new JitWrap(std::move(jitter)));
+    engine->mCode->mObjectCache.reset(new JitObjectCache(cacheDirectory));
+    engine->CompleteBuild();
+    return std::unique_ptr<IEngine>(std::move(engine));
 }
 
-std::unique_ptr<IEngine> JitWrap::Build(const std::string& text)
+std::unique_ptr<IEngine> JitWrap::BuildProfiled(const std::string& text, Jitter::ProfileMode mode)
 {
     auto jitter = Jitter::Build(text);
+    jitter->SetProfileMode(mode);
     auto engine = std::unique_ptr<JitWrap>(new JitWrap(std::move(jitter)));
     engine->CompleteBuild();
     return std::unique_ptr<IEngine>(std::move(engine));
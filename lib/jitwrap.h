@@ -11,11 +11,31 @@
 
 #include "exys.h"
 #include "jitter.h"
+#include "pointengine.h"
+#include "jitcache.h"
 
 namespace Exys
 {
 
-class JitWrap : public IEngine
+// Compiled code of a graph. Shared by an engine and
+// its copies so the code stays loaded until the last of them is
+// destroyed. Members go bottom up so the execution engine is torn
+// down before the context
+struct JitCode
+{
+    std::unique_ptr<Jitter> mJitter;
+    std::unique_ptr<JitObjectCache> mObjectCache;
+    std::unique_ptr<llvm::ExecutionEngine> mExecEngine;
+
+    std::vector<std::string> mSimFuncTargets;
+
+    // Owned by the module. Null unless the jitter was profiling
+    uint64_t* mProfileCounters = nullptr;
+
+    ~JitCode();
+};
+
+class JitWrap : public CompiledEngine
 {
 public:
     JitWrap(std::unique_ptr<Jitter> graph);
@@ -23,55 +43,33 @@ public:
 
     virtual ~JitWrap();
 
-    void Stabilize(bool force=false) override;
-    bool IsDirty() const override;
-
-    bool HasInputPoint(const std::string& label) const override;
-    Point& LookupInputPoint(const std::string& label) override;
-    std::vector<std::string> GetInputPointLabels() const override;
-    std::vector<std::pair<std::string, double>> DumpInputs() const override;
-
-    bool HasObserverPoint(const std::string& label) const override;
-    Point& LookupObserverPoint(const std::string& label) override;
-    std::vector<std::string> GetObserverPointLabels() const override;
-    std::vector<std::pair<std::string, double>> DumpObservers() const override;
-
-    bool SupportSimulation() const override;
-    int GetNumSimulationFunctions() const override;
-    void CaptureState() override;
-    void ResetState() override;
-    bool RunSimulationId(int simId) override;
     std::string GetNumSimulationTarget(int simId) const override;
 
     std::string GetDOTGraph() const override;
 
     void CopyState(JitWrap& jw);
 
+    // Counts from a profiled build. Copies share code and with
+    // it the counters so these cover every engine using the code
+    std::vector<NodeProfile> GetProfile() const;
+    void ResetProfile();
+    std::string GetProfileReport() const;
+    std::string GetProfileDOTGraph() const;
+
+    // Compiled code is cached in EXYS_JIT_CACHE if set or cacheDirectory
     static std::unique_ptr<IEngine> Build(const std::string& text);
+    static std::unique_ptr<IEngine> Build(const std::string& text, const std::string& cacheDirectory);
+
+    // Build with the profiling counters compiled in. Setting
+    // EXYS_JIT_PROFILE to counts or cycles does the same for Build
+    static std::unique_ptr<IEngine> BuildProfiled(const std::string& text,
+            Jitter::ProfileMode mode=Jitter::PROFILE_CYCLES);
 
 private:
     void BuildJitEngine(std::unique_ptr<llvm::Module> module);
-    void SetPointPtrs();
     void CompleteBuild();
 
-    InitFunc mInitFunc = nullptr;
-    StabilizationFunc mRawStabilizeFunc = nullptr;
-    SimFunc mRawSimFunc = nullptr;
-
-    int mSimFuncCount = 0;
-    std::vector<std::string> mSimFuncTargets;
-    
-    std::vector<double> mState;
-    std::vector<double> mStateCapture;
-    std::vector<Point> mPoints;
-    std::vector<Point> mPointsCapture;
-    Point* mInputPtr = nullptr;
-    Point* mObserverPtr = nullptr;
-    int mInputSize = 0;
-    std::unordered_map<std::string, int> mObserverOffsets;
-    std::unordered_map<std::string, int> mInputOffsets;
-
-    std::unique_ptr<Jitter> mJitter;
+    std::shared_ptr<JitCode> mCode;
 };
 
 
@@ -0,0 +1,193 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "modulecache.h"
+#include "std/stdlib.h"
+
+namespace
+{
+    constexpr char EXYS_REQUIRE_PATH[] = "EXYS_REQUIRE_PATH";
+    constexpr char STDLIB_PREFIX[] = "std:";
+
+    bool StatFile(const std::string& path, struct stat& info)
+    {
+        return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+    }
+
+    int64_t GetModified(const struct stat& info)
+    {
+#if defined(__APPLE__)
+        return int64_t(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+        return int64_t(info.st_mtime) * 1000000000;
+#else
+        return int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    }
+
+    // The path the name resolves to on disk, or the name with the
+    // standard library prefix if it is only in the compiled library
+    bool ResolveSource(const std::string& name, std::string& path, struct stat& info)
+    {
+        if(StatFile(name, info))
+        {
+            path = name;
+            return true;
+        }
+
+        const char* searchPath = getenv(EXYS_REQUIRE_PATH);
+        std::stringstream ss(searchPath ? searchPath : "");
+        std::string dir;
+        while(std::getline(ss, dir, ':'))
+        {
+            if(dir.empty()) continue;
+            if(StatFile(dir + "/" + name, info))
+            {
+                path = dir + "/" + name;
+                return true;
+            }
+        }
+
+        for(const auto& entry : Exys::StdLibEntries)
+        {
+            if(entry.name == name)
+            {
+                path = STDLIB_PREFIX + name;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const Exys::StdLibEntry* FindStdLibEntry(const std::string& path)
+    {
+        if(path.compare(0, sizeof(STDLIB_PREFIX) - 1, STDLIB_PREFIX) != 0) return nullptr;
+        const auto name = path.substr(sizeof(STDLIB_PREFIX) - 1);
+        for(const auto& entry : Exys::StdLibEntries)
+        {
+            if(entry.name == name) return &entry;
+        }
+        return nullptr;
+    }
+}
+
+namespace Exys
+{
+
+SourceFile::~SourceFile()
+{
+#ifndef _WIN32
+    if(mMapped) munmap(const_cast<char*>(mData), mSize);
+#endif
+}
+
+std::unique_ptr<SourceFile> SourceFile::Open(const std::string& path)
+{
+    auto file = std::unique_ptr<SourceFile>(new SourceFile);
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) return nullptr;
+
+    struct stat info;
+    if(fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED)
+        {
+            file->mData = static_cast<const char*>(data);
+            file->mSize = info.st_size;
+            file->mMapped = true;
+        }
+    }
+    close(fd);
+    if(file->mMapped) return file;
+#endif
+
+    std::ifstream t(path, std::ios::binary);
+    if(!t.good()) return nullptr;
+    std::stringstream buffer;
+    buffer << t.rdbuf();
+    file->mBuffer = buffer.str();
+    file->mData = file->mBuffer.data();
+    file->mSize = file->mBuffer.size();
+    return file;
+}
+
+bool ReadSource(const std::string& name, std::string& out)
+{
+    std::string path;
+    struct stat info;
+    if(!ResolveSource(name, path, info)) return false;
+
+    if(const auto* entry = FindStdLibEntry(path))
+    {
+        out.assign(reinterpret_cast<const char*>(entry->data), entry->len);
+        return true;
+    }
+    auto file = SourceFile::Open(path);
+    if(!file) return false;
+    out.assign(file->GetData(), file->GetSize());
+    return true;
+}
+
+ModuleCache& ModuleCache::Get()
+{
+    static ModuleCache cache;
+    return cache;
+}
+
+std::shared_ptr<const Cell> ModuleCache::Load(const std::string& name)
+{
+    std::string path;
+    struct stat info;
+    if(!ResolveSource(name, path, info)) return nullptr;
+
+    const auto* entry = FindStdLibEntry(path);
+    const int64_t modified = entry ? 0 : GetModified(info);
+    const int64_t size = entry ? entry->len : info.st_size;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto miter = mModules.find(path);
+        if(miter != mModules.end() && miter->second.mModified == modified && miter->second.mSize == size)
+        {
+            return miter->second.mCell;
+        }
+    }
+
+    // Parsed outside the lock so one large file doesn't hold up
+    // graphs requiring others. Two threads may parse the same file
+    std::shared_ptr<const Cell> cell;
+    if(entry)
+    {
+        cell = std::make_shared<const Cell>(Parse(reinterpret_cast<const char*>(entry->data), entry->len));
+    }
+    else
+    {
+        auto file = SourceFile::Open(path);
+        if(!file) return nullptr;
+        cell = std::make_shared<const Cell>(Parse(file->GetData(), file->GetSize()));
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto& module = mModules[path];
+    module.mModified = modified;
+    module.mSize = size;
+    module.mCell = cell;
+    return cell;
+}
+
+void ModuleCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mModules.clear();
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "parser.h"
+
+namespace Exys
+{
+
+// A source file mapped read only into memory. Read into a buffer
+// instead where there is no mmap
+class SourceFile
+{
+public:
+    ~SourceFile();
+
+    // Null if the file can't be opened
+    static std::unique_ptr<SourceFile> Open(const std::string& path);
+
+    const char* GetData() const { return mData; }
+    size_t GetSize() const { return mSize; }
+
+private:
+    SourceFile() {}
+
+    const char* mData = nullptr;
+    size_t mSize = 0;
+    bool mMapped = false;
+    std::string mBuffer;
+};
+
+// Sources of required files, searched for as given, then in each
+// directory of EXYS_REQUIRE_PATH, then in the compiled standard library
+bool ReadSource(const std::string& name, std::string& out);
+
+// One per process. Parsed required files shared by every graph that
+// requires them. Files on disk are parsed again when their size or
+// modification time changes
+class ModuleCache
+{
+public:
+    static ModuleCache& Get();
+
+    // Null if the file can't be found. Parse errors are thrown
+    std::shared_ptr<const Cell> Load(const std::string& name);
+    void Clear();
+
+private:
+    ModuleCache() {}
+
+    struct Module
+    {
+        int64_t mModified = 0;
+        int64_t mSize = 0;
+        std::shared_ptr<const Cell> mCell;
+    };
+
+    std::mutex mMutex;
+    std::unordered_map<std::string, Module> mModules;
+};
+
+}
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <algorithm>
 #include <stack>
+#include <iterator>
 
 #include "parser.h"
 #include "helpers.h"
@@ -10,94 +11,121 @@
 namespace Exys
 {
 
-// convert given string to list of tokens
-std::list<TokenDetails> Tokenize(const std::string & str)
+std::string TokenRef::GetText() const
 {
-    std::list<TokenDetails> tokens;
+    if(!escaped) return std::string(data, size);
 
-    bool inComment = false;
-    bool inString = false;
+    // Drop each backslash and keep what it escapes
+    std::string text;
+    text.reserve(size);
+    for(size_t i = 0; i < size; ++i)
+    {
+        if(data[i] == '\\' && ++i == size) break;
+        text += data[i];
+    }
+    return text;
+}
 
-    std::string tok;
-    int lineNumber = 0;
-    int column = -1;
-    int startLineNumber = 0;
-    int startColumn = 0;
+TokenDetails TokenRef::GetDetails() const
+{
+    return {GetText(), firstLineNumber, firstColumn, endLineNumber, endColumn};
+}
 
-    auto trypushtoken = [&]()
-    {
-        if(tok.size())
-        {
-            tokens.push_back({tok, startLineNumber, startColumn, lineNumber, static_cast<int>(startColumn+tok.size()-1)});
-            tok.clear();
-        }
-    };
+Tokenizer::Tokenizer(const std::string& str)
+: Tokenizer(str.data(), str.size())
+{
+}
 
-    for(auto s = str.begin(); s != str.end(); ++s)
+Tokenizer::Tokenizer(const char* data, size_t size)
+: mPos(data)
+, mEnd(data + size)
+{
+}
+
+// An escaped character counts as one column with its backslash and
+// new lines inside strings don't count as lines
+bool Tokenizer::Next(TokenRef& token)
+{
+    while(mPos != mEnd)
     {
-        ++column;
-        if(*s == '\\') // escape next char
+        if(*mPos == '\n')
         {
-            ++s;
+            ++mLineNumber;
+            mColumn = 0;
+            ++mPos;
         }
-        else if(*s == '"')
+        else if(*mPos == ';')
         {
-            inString = !inString;
+            while(mPos != mEnd && *mPos != '\n') ++mPos;
         }
-        else if(inString)
+        else if(iswspace(*mPos))
         {
-            // nop
+            ++mColumn;
+            ++mPos;
         }
-        else if(*s == ';')
-        {
-            inComment = true;
-            continue;
-        }
-        else if(*s == '\n')
-        {
-            trypushtoken();
-            inComment = false;
-            ++lineNumber;
-            column = -1;
-            continue;
-        }
-        else if(inComment)
-        {
-            trypushtoken();
-            continue;
-        }
-        else if(*s == '(')
-        {
-            trypushtoken();
-            tok = "(";
-            startLineNumber = lineNumber;
-            startColumn = column;
-            trypushtoken();   
-            continue;
-        }
-        else if(*s == ')')
-        {
-            trypushtoken();
-            tok = ")";
-            startLineNumber = lineNumber;
-            startColumn = column;
-            trypushtoken();   
-            continue;
-        }
-        else if (iswspace(*s))
+        else
         {
-            trypushtoken();   
-            continue;
+            break;
         }
+    }
+    if(mPos == mEnd) return false;
+
+    token.data = mPos;
+    token.escaped = false;
+    token.firstLineNumber = mLineNumber;
+    token.firstColumn = mColumn;
+    token.endLineNumber = mLineNumber;
 
-        if(!tok.size())
+    int length = 0;
+    if(*mPos == '(' || *mPos == ')')
+    {
+        ++mPos;
+        length = 1;
+    }
+    else
+    {
+        bool inString = false;
+        while(mPos != mEnd)
         {
-            startLineNumber = lineNumber;   
-            startColumn = column;   
+            const char c = *mPos;
+            if(c == '\\')
+            {
+                token.escaped = true;
+                if(++mPos != mEnd) ++mPos;
+            }
+            else if(c == '"')
+            {
+                inString = !inString;
+                ++mPos;
+            }
+            else if(!inString && (c == '(' || c == ')' || c == ';' || iswspace(c)))
+            {
+                break;
+            }
+            else
+            {
+                ++mPos;
+            }
+            ++length;
         }
-        tok.append(1, *s);
     }
 
+    mColumn += length;
+    token.size = mPos - token.data;
+    token.endColumn = token.firstColumn + length - 1;
+    return true;
+}
+
+// convert given string to list of tokens
+std::list<TokenDetails> Tokenize(const std::string & str)
+{
+    std::list<TokenDetails> tokens;
+    Tokenizer tokenizer(str);
+    TokenRef token;
+    while(tokenizer.Next(token))
+    {
+        tokens.push_back(token.GetDetails());
+    }
     return tokens;
 }
 
@@ -111,7 +139,7 @@ Cell Atom(TokenDetails token)
         (token.text.size() > 1 && token.text[0] == '-' && std::isdigit(token.text[1]))
     )
     {
-        return Cell::Number(token);
+        return Cell::Number(std::move(token));
     }
     else if (token.text.size() && token.text[0] == '"')
     {
@@ -119,9 +147,9 @@ Cell Atom(TokenDetails token)
         {
             throw ParseException("Missing closing quote", token);
         }
-        return Cell::String(token);
+        return Cell::String(std::move(token));
     }
-    return Cell::Symbol(token);
+    return Cell::Symbol(std::move(token));
 }
 
 // return the Lisp expression in the given tokens
@@ -174,8 +202,57 @@ Cell ReadFromTokenDetails(const std::list<TokenDetails>& tokens)
 
 Cell Parse(const std::string& val)
 {
-    auto tokens = Tokenize(val);
-    return ReadFromTokenDetails(tokens);
+    return Parse(val.data(), val.size());
+}
+
+// Reads straight from the tokenizer. Children of open lists wait on
+// one stack and move into their list when it closes, so each list
+// allocates once at its final size
+Cell Parse(const char* data, size_t size)
+{
+    Cell root = Cell::Root();
+    std::vector<Cell> pending;
+    std::vector<size_t> openLists;
+
+    auto moveChildren = [&pending](std::vector<Cell>& list, size_t first)
+    {
+        list.reserve(pending.size() - first);
+        std::move(pending.begin() + first, pending.end(), std::back_inserter(list));
+        pending.erase(pending.begin() + first, pending.end());
+    };
+
+    Tokenizer tokenizer(data, size);
+    TokenRef token;
+    while(tokenizer.Next(token))
+    {
+        if(token.Is('('))
+        {
+            openLists.push_back(pending.size());
+            pending.emplace_back(Cell::List(token.GetDetails()));
+        }
+        else if(token.Is(')'))
+        {
+            if(openLists.empty())
+            {
+                throw ParseException("Extra closing parentheses", token.GetDetails());
+            }
+            const auto open = openLists.back();
+            openLists.pop_back();
+            moveChildren(pending[open].list, open + 1);
+        }
+        else
+        {
+            pending.emplace_back(Atom(token.GetDetails()));
+        }
+    }
+
+    if(!openLists.empty())
+    {
+        throw ParseException("Opened parentheses not closed", pending[openLists.back()].details);
+    }
+
+    moveChildren(root.list, 0);
+    return root;
 }
 
 ParseException::ParseException(const std::string& error, TokenDetails details)
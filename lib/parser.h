@@ -3,6 +3,9 @@
 #include <vector>
 #include <string>
 #include <list>
+#include <utility>
+
+#include "symbol.h"
 
 namespace Exys
 {
@@ -30,6 +33,8 @@ struct Cell
     
     Type type = NONE;
     TokenDetails details;
+    // Interned text of symbols, NO_SYMBOL for anything else
+    Exys::Symbol symbol = NO_SYMBOL;
 
     std::vector<Cell> list;
 
@@ -40,11 +45,12 @@ struct Cell
         return c;
     }
 
-    static Cell Symbol(const TokenDetails& details) 
+    static Cell Symbol(TokenDetails details) 
     {
         Cell c;
         c.type = SYMBOL;
-        c.details = details;
+        c.details = std::move(details);
+        c.symbol = SymbolTable::Get().Intern(c.details.text);
         return c;
     }
 
@@ -53,35 +59,70 @@ struct Cell
         Cell c;
         c.type = SYMBOL;
         c.details.text = token;
+        c.symbol = SymbolTable::Get().Intern(token);
         return c;
     }
 
-    static Cell Number(const TokenDetails& details) 
+    static Cell Number(TokenDetails details) 
     {
         Cell c;
         c.type = NUMBER;
-        c.details = details;
+        c.details = std::move(details);
         return c;
     }
 
-    static Cell String(const TokenDetails& details) 
+    static Cell String(TokenDetails details) 
     {
         Cell c;
         c.type = STRING;
-        c.details = details;
-        c.details.text = details.text.substr(1, details.text.size()-2);
+        c.details = std::move(details);
+        c.details.text = c.details.text.substr(1, c.details.text.size()-2);
         return c;
     }
 
-    static Cell List(const TokenDetails& details) 
+    static Cell List(TokenDetails details) 
     {
         Cell c;
         c.type = LIST;
-        c.details = details;
+        c.details = std::move(details);
         return c;
     }
 };
 
+// A token as it sits in the source. Only valid while the source is.
+// Escaped tokens still hold their backslashes until copied out
+struct TokenRef
+{
+    const char* data = nullptr;
+    size_t size = 0;
+    bool escaped = false;
+    int firstLineNumber = 0;
+    int firstColumn = 0;
+    int endLineNumber = 0;
+    int endColumn = 0;
+
+    bool Is(char c) const { return size == 1 && *data == c; }
+    std::string GetText() const;
+    TokenDetails GetDetails() const;
+};
+
+// Reads tokens one at a time straight out of the source without
+// copying them
+class Tokenizer
+{
+public:
+    explicit Tokenizer(const std::string& str);
+    Tokenizer(const char* data, size_t size);
+
+    bool Next(TokenRef& token);
+
+private:
+    const char* mPos;
+    const char* mEnd;
+    int mLineNumber = 0;
+    int mColumn = 0;
+};
+
 class ParseException : public std::exception
 {
 public:
@@ -99,5 +140,6 @@ Cell Atom(TokenDetails token);
 Cell ReadFromTokenDetails(const std::list<TokenDetails>& tokens);
 
 Cell Parse(const std::string& val);
+Cell Parse(const char* data, size_t size);
 
 }
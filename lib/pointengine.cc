@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cassert>
+
+#include "pointengine.h"
+#include "helpers.h"
+
+namespace Exys
+{
+
+PointEngine::PointEngine()
+: mLabels(std::make_shared<PointLabels>())
+{
+}
+
+PointEngine::PointEngine(const PointEngine& engine)
+: mPoints(engine.mPoints)
+, mLabels(engine.mLabels)
+, mBatchStamps(engine.mBatchStamps)
+, mBatchGeneration(engine.mBatchGeneration)
+{
+}
+
+bool PointEngine::IsDirty() const
+{
+    for(const auto& namep : mLabels->mInputOffsets)
+    {
+        const auto& point = mPoints[namep.second];
+        if(point.IsDirty()) return true;
+    }
+    return false;
+}
+
+bool PointEngine::HasInputPoint(const std::string& label) const
+{
+    auto niter = mLabels->mInputOffsets.find(label);
+    return niter != mLabels->mInputOffsets.end();
+}
+
+Point& PointEngine::LookupInputPoint(const std::string& label)
+{
+    assert(HasInputPoint(label));
+    auto niter = mLabels->mInputOffsets.find(label);
+    return mPoints[niter->second];
+}
+
+std::vector<std::string> PointEngine::GetInputPointLabels() const
+{
+    std::vector<std::string> ret;
+    for(const auto& ip : mLabels->mInputOffsets)
+    {
+        ret.push_back(ip.first);
+    }
+    return ret;
+}
+
+std::vector<std::pair<std::string, double>> PointEngine::DumpInputs() const
+{
+    std::vector<std::pair<std::string, double>> ret;
+    DumpInputs(ret);
+    return ret;
+}
+
+void PointEngine::DumpInputs(std::vector<std::pair<std::string, double>>& values) const
+{
+    FillPointValues(mLabels->mInputOffsets, [this](int offset) { return mPoints[offset].mVal; }, values);
+}
+
+bool PointEngine::HasObserverPoint(const std::string& label) const
+{
+    auto niter = mLabels->mObserverOffsets.find(label);
+    return niter != mLabels->mObserverOffsets.end();
+}
+
+Point& PointEngine::LookupObserverPoint(const std::string& label)
+{
+    assert(HasObserverPoint(label));
+    auto niter = mLabels->mObserverOffsets.find(label);
+    return mPoints[niter->second];
+}
+
+std::vector<std::string> PointEngine::GetObserverPointLabels() const
+{
+    std::vector<std::string> ret;
+    for(const auto& ip : mLabels->mObserverOffsets)
+    {
+        ret.push_back(ip.first);
+    }
+    return ret;
+}
+
+std::vector<std::pair<std::string, double>> PointEngine::DumpObservers() const
+{
+    std::vector<std::pair<std::string, double>> ret;
+    DumpObservers(ret);
+    return ret;
+}
+
+void PointEngine::DumpObservers(std::vector<std::pair<std::string, double>>& values) const
+{
+    FillPointValues(mLabels->mObserverOffsets, [this](int offset) { return mPoints[offset].mVal; }, values);
+}
+
+InputHandle PointEngine::ResolveInput(const std::string& label) const
+{
+    InputHandle handle;
+    auto niter = mLabels->mInputOffsets.find(label);
+    if(niter != mLabels->mInputOffsets.end())
+    {
+        handle.mIndex = niter->second;
+    }
+    return handle;
+}
+
+Point& PointEngine::LookupInputPoint(InputHandle handle)
+{
+    assert(handle.mIndex < mPoints.size());
+    return mPoints[handle.mIndex];
+}
+
+void PointEngine::SetInput(InputHandle handle, double value)
+{
+    assert(handle.mIndex < mPoints.size());
+    mPoints[handle.mIndex] = value;
+}
+
+void PointEngine::SetInputs(const InputHandle* handles, const double* values, size_t count)
+{
+    for(size_t i = 0; i < count; ++i)
+    {
+        assert(handles[i].mIndex < mPoints.size());
+        mPoints[handles[i].mIndex] = values[i];
+    }
+}
+
+void PointEngine::ApplyBatch(const InputUpdate* updates, size_t count)
+{
+    if(++mBatchGeneration == 0)
+    {
+        std::fill(mBatchStamps.begin(), mBatchStamps.end(), 0);
+        mBatchGeneration = 1;
+    }
+
+    // Walk backwards so only the last write to each input lands
+    for(size_t i = count; i-- > 0;)
+    {
+        const auto index = updates[i].mHandle.mIndex;
+        assert(index < mBatchStamps.size());
+        if(mBatchStamps[index] == mBatchGeneration) continue;
+        mBatchStamps[index] = mBatchGeneration;
+        mPoints[index] = updates[i].mVal;
+    }
+    Stabilize();
+}
+
+ObserverHandle PointEngine::ResolveObserver(const std::string& label) const
+{
+    ObserverHandle handle;
+    auto niter = mLabels->mObserverOffsets.find(label);
+    if(niter != mLabels->mObserverOffsets.end())
+    {
+        handle.mIndex = niter->second;
+    }
+    return handle;
+}
+
+Point& PointEngine::LookupObserverPoint(ObserverHandle handle)
+{
+    assert(handle.mIndex < mPoints.size());
+    return mPoints[handle.mIndex];
+}
+
+double PointEngine::ReadObserver(ObserverHandle handle) const
+{
+    assert(handle.mIndex < mPoints.size());
+    return mPoints[handle.mIndex].mVal;
+}
+
+void PointEngine::EnableStats(bool enable)
+{
+    mStats.Enable(enable);
+}
+
+void PointEngine::ResetStats()
+{
+    mStats.Reset();
+}
+
+EngineStats PointEngine::GetStats() const
+{
+    return mStats.GetStats();
+}
+
+CompiledEngine::CompiledEngine(const CompiledEngine& engine)
+: PointEngine(engine)
+, mInitFunc(engine.mInitFunc)
+, mRawStabilizeFunc(engine.mRawStabilizeFunc)
+, mRawSimFunc(engine.mRawSimFunc)
+, mSimFuncCount(engine.mSimFuncCount)
+, mState(engine.mState)
+, mInputSize(engine.mInputSize)
+{
+    SetPointPtrs();
+}
+
+void CompiledEngine::SetPointPtrs()
+{
+    mInputPtr = mPoints.data();
+    mObserverPtr = mPoints.data() + mInputSize;
+}
+
+void CompiledEngine::Stabilize(bool force)
+{
+    // Stabilize function checks the input dirty flags
+    // itself and only recomputes what hangs off them
+    if(force)
+    {
+        for(int i = 0; i < mInputSize; ++i) mInputPtr[i].mDirty = true;
+    }
+    if(!mStats.IsEnabled())
+    {
+        mRawStabilizeFunc(mInputPtr, mObserverPtr, mState.data());
+        for(auto& p : mPoints) p.Clean();
+        return;
+    }
+
+    uint64_t dirtyInputs = 0;
+    for(int i = 0; i < mInputSize; ++i)
+    {
+        if(mInputPtr[i].IsDirty()) ++dirtyInputs;
+    }
+    const auto start = StatsRecorder::Now();
+    mRawStabilizeFunc(mInputPtr, mObserverPtr, mState.data());
+    mStats.RecordStabilize(StatsRecorder::Now() - start, dirtyInputs);
+    for(auto& p : mPoints) p.Clean();
+}
+
+bool CompiledEngine::SupportSimulation() const
+{
+    return true;
+}
+
+int CompiledEngine::GetNumSimulationFunctions() const
+{
+    return mSimFuncCount;
+}
+
+void CompiledEngine::CaptureState()
+{
+    mPointsCapture = mPoints;
+    mStateCapture = mState;
+}
+
+void CompiledEngine::ResetState()
+{
+    mPoints = mPointsCapture;
+    mState = mStateCapture;
+}
+
+bool CompiledEngine::RunSimulationId(int simId)
+{
+    assert(mRawSimFunc && "Simulation function does not exist");
+    if(!mRawSimFunc) return true;
+    if(!mStats.IsEnabled())
+    {
+        mRawSimFunc(mInputPtr, mInputPtr, mState.data(), simId);
+        return mInputPtr[mInputSize] != 0.0;
+    }
+
+    const auto start = StatsRecorder::Now();
+    mRawSimFunc(mInputPtr, mInputPtr, mState.data(), simId);
+    mStats.RecordSimulation(StatsRecorder::Now() - start);
+    return mInputPtr[mInputSize] != 0.0;
+}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+
+#include "exys.h"
+#include "enginestats.h"
+
+namespace Exys
+{
+
+// Signatures of the functions generated for a graph, whether
+// jitted or compiled ahead of time
+typedef void (*InitFunc)(double* state);
+typedef void (*StabilizationFunc)(Point* inputs, Point* observers, double* state);
+typedef void (*SimFunc)(Point* inputs, Point* inputsAndDone, double* state, int simId);
+
+// Where the point of each input and observer label sits
+struct PointLabels
+{
+    std::unordered_map<std::string, int> mInputOffsets;
+    std::unordered_map<std::string, int> mObserverOffsets;
+};
+
+// Engines that keep their inputs and observers in one array of points.
+// Handles are offsets into it so labels, handles, batches and stats
+// work the same for all of them
+class PointEngine : public IEngine
+{
+public:
+    bool IsDirty() const override;
+
+    bool HasInputPoint(const std::string& label) const override;
+    Point& LookupInputPoint(const std::string& label) override;
+    std::vector<std::string> GetInputPointLabels() const override;
+    std::vector<std::pair<std::string, double>> DumpInputs() const override;
+    void DumpInputs(std::vector<std::pair<std::string, double>>& values) const override;
+
+    bool HasObserverPoint(const std::string& label) const override;
+    Point& LookupObserverPoint(const std::string& label) override;
+    std::vector<std::string> GetObserverPointLabels() const override;
+    std::vector<std::pair<std::string, double>> DumpObservers() const override;
+    void DumpObservers(std::vector<std::pair<std::string, double>>& values) const override;
+
+    InputHandle ResolveInput(const std::string& label) const override;
+    Point& LookupInputPoint(InputHandle handle) override;
+    void SetInput(InputHandle handle, double value) override;
+    void SetInputs(const InputHandle* handles, const double* values, size_t count) override;
+    void ApplyBatch(const InputUpdate* updates, size_t count) override;
+
+    ObserverHandle ResolveObserver(const std::string& label) const override;
+    Point& LookupObserverPoint(ObserverHandle handle) override;
+    double ReadObserver(ObserverHandle handle) const override;
+
+    void EnableStats(bool enable) override;
+    void ResetStats() override;
+    EngineStats GetStats() const override;
+
+protected:
+    PointEngine();
+    // Copies share the labels and start with stats off
+    PointEngine(const PointEngine& engine);
+
+    std::vector<Point> mPoints;
+    std::shared_ptr<PointLabels> mLabels;
+
+    // Points written by the current batch are stamped with its
+    // generation. Only needs to cover the points inputs can be
+    std::vector<uint32_t> mBatchStamps;
+    uint32_t mBatchGeneration = 0;
+
+    StatsRecorder mStats;
+};
+
+// Engines running generated code. Inputs come first in the points
+// followed by the observers and then the done flag of simulations
+class CompiledEngine : public PointEngine
+{
+public:
+    void Stabilize(bool force=false) override;
+
+    bool SupportSimulation() const override;
+    int GetNumSimulationFunctions() const override;
+    void CaptureState() override;
+    void ResetState() override;
+    bool RunSimulationId(int simId) override;
+
+protected:
+    CompiledEngine() {}
+    // Copies don't take the captured state
+    CompiledEngine(const CompiledEngine& engine);
+
+    // Call again whenever mPoints is reassigned
+    void SetPointPtrs();
+
+    InitFunc mInitFunc = nullptr;
+    StabilizationFunc mRawStabilizeFunc = nullptr;
+    SimFunc mRawSimFunc = nullptr;
+
+    int mSimFuncCount = 0;
+
+    std::vector<double> mState;
+    std::vector<double> mStateCapture;
+    std::vector<Point> mPointsCapture;
+    Point* mInputPtr = nullptr;
+    Point* mObserverPtr = nullptr;
+    int mInputSize = 0;
+};
+
+};
@@ -0,0 +1,167 @@
+#ifndef _WIN32
+
+#include <cassert>
+
+#include "simulationpool.h"
+
+namespace Exys
+{
+
+SimulationPool::SimulationPool(JitWrap& engine, size_t numThreads)
+{
+    assert(numThreads > 0);
+    for(size_t i = 0; i < numThreads; ++i)
+    {
+        mWorkers.emplace_back(new Worker);
+        mWorkers.back()->mEngine.reset(new JitWrap(engine));
+    }
+    CaptureState(engine);
+
+    for(size_t i = 0; i < numThreads; ++i)
+    {
+        mWorkers[i]->mThread = std::thread(&SimulationPool::WorkerLoop, this, i);
+    }
+}
+
+SimulationPool::~SimulationPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mStart.notify_all();
+    for(auto& worker : mWorkers)
+    {
+        worker->mThread.join();
+    }
+}
+
+void SimulationPool::CaptureState(JitWrap& engine)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    assert(!mRunning && "Can't capture while simulations are running");
+    for(auto& worker : mWorkers)
+    {
+        worker->mEngine->CopyState(engine);
+    }
+}
+
+std::vector<SimulationResult> SimulationPool::Run(const std::vector<SimulationJob>& jobs,
+        const std::vector<ObserverHandle>& observers, int maxSteps)
+{
+    std::vector<SimulationResult> results(jobs.size());
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mJobs = &jobs;
+    mObserverHandles = &observers;
+    mResults = &results;
+    mMaxSteps = maxSteps;
+
+    // Deal out contiguous runs so neighbouring jobs share a thread
+    const size_t numWorkers = mWorkers.size();
+    for(size_t w = 0; w < numWorkers; ++w)
+    {
+        auto& worker = *mWorkers[w];
+        std::lock_guard<std::mutex> queueLock(worker.mQueueMutex);
+        const size_t begin = (jobs.size() * w) / numWorkers;
+        const size_t end = (jobs.size() * (w + 1)) / numWorkers;
+        for(size_t job = begin; job < end; ++job)
+        {
+            worker.mQueue.push_back(job);
+        }
+    }
+
+    mRunning = numWorkers;
+    ++mBatch;
+    mStart.notify_all();
+    mFinished.wait(lock, [this]{ return mRunning == 0; });
+
+    mJobs = nullptr;
+    mObserverHandles = nullptr;
+    mResults = nullptr;
+    return results;
+}
+
+void SimulationPool::WorkerLoop(size_t id)
+{
+    uint64_t batch = 0;
+    auto& engine = *mWorkers[id]->mEngine;
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStart.wait(lock, [this, batch]{ return mStop || (mBatch != batch); });
+            if(mStop) return;
+            batch = mBatch;
+        }
+
+        size_t job = 0;
+        while(NextJob(id, job))
+        {
+            RunJob(engine, job);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mRunning;
+        }
+        mFinished.notify_one();
+    }
+}
+
+bool SimulationPool::NextJob(size_t id, size_t& job)
+{
+    {
+        auto& own = *mWorkers[id];
+        std::lock_guard<std::mutex> lock(own.mQueueMutex);
+        if(own.mQueue.size())
+        {
+            job = own.mQueue.front();
+            own.mQueue.pop_front();
+            return true;
+        }
+    }
+
+    // Steal from the far end of someone else's queue
+    for(size_t i = 1; i < mWorkers.size(); ++i)
+    {
+        auto& other = *mWorkers[(id + i) % mWorkers.size()];
+        std::lock_guard<std::mutex> lock(other.mQueueMutex);
+        if(other.mQueue.size())
+        {
+            job = other.mQueue.back();
+            other.mQueue.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void SimulationPool::RunJob(JitWrap& engine, size_t job)
+{
+    const auto& simJob = (*mJobs)[job];
+    auto& result = (*mResults)[job];
+
+    engine.ResetState();
+    for(const auto& update : simJob.mInputs)
+    {
+        engine.SetInput(update.mHandle, update.mVal);
+    }
+    engine.Stabilize();
+
+    for(int step = 0; step < mMaxSteps && !result.mDone; ++step)
+    {
+        result.mDone = engine.RunSimulationId(simJob.mSimId);
+    }
+    engine.Stabilize();
+
+    result.mObservers.reserve(mObserverHandles->size());
+    for(const auto& handle : *mObserverHandles)
+    {
+        result.mObservers.push_back(engine.ReadObserver(handle));
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef _WIN32
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "exys.h"
+#include "jitwrap.h"
+
+namespace Exys
+{
+
+struct SimulationJob
+{
+    int mSimId = 0;
+    // Written over the captured state before the simulation runs
+    std::vector<InputUpdate> mInputs;
+};
+
+struct SimulationResult
+{
+    // False if the simulation hadn't flagged done after the step limit
+    bool mDone = false;
+    // One value per observer handle passed to Run
+    std::vector<double> mObservers;
+};
+
+// Runs simulations from a captured engine state on a pool of threads.
+// Each thread owns a JitWrap clone with its own memory. Jobs are dealt
+// out evenly and threads that run dry steal from the back of the others
+class SimulationPool
+{
+public:
+    SimulationPool(JitWrap& engine, size_t numThreads);
+    ~SimulationPool();
+
+    // Every job starts from the engine state at the time of this call
+    void CaptureState(JitWrap& engine);
+
+    std::vector<SimulationResult> Run(const std::vector<SimulationJob>& jobs,
+            const std::vector<ObserverHandle>& observers, int maxSteps=1000);
+
+private:
+    struct Worker
+    {
+        std::unique_ptr<JitWrap> mEngine;
+        std::mutex mQueueMutex;
+        std::deque<size_t> mQueue;
+        std::thread mThread;
+    };
+
+    void WorkerLoop(size_t id);
+    bool NextJob(size_t id, size_t& job);
+    void RunJob(JitWrap& engine, size_t job);
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    // Current batch. Only touched by workers between start and finish
+    const std::vector<SimulationJob>* mJobs = nullptr;
+    const std::vector<ObserverHandle>* mObserverHandles = nullptr;
+    std::vector<SimulationResult>* mResults = nullptr;
+    int mMaxSteps = 0;
+
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mFinished;
+    uint64_t mBatch = 0;
+    size_t mRunning = 0;
+    bool mStop = false;
+};
+
+};
+#endif
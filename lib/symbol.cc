@@ -0,0 +1,98 @@
+#include <cassert>
+#include <functional>
+
+#include "symbol.h"
+
+namespace
+{
+    const char* FIXED_SYMBOL_NAMES[] =
+    {
+        "",
+        "begin", "define", "defvar", "set!", "lambda",
+        "input", "input-list", "observe", "provide",
+        "?", "+", "-", "/", "*", "%", "<", "<=", ">", ">=", "==", "!=",
+        "&&", "||", "min", "max", "exp", "ln", "trunc", "not",
+        "tick", "copy", "load", "store", "sim-apply",
+        "rolling-sum", "rolling-mean", "rolling-min", "rolling-max"
+    };
+
+    static_assert(sizeof(FIXED_SYMBOL_NAMES) / sizeof(FIXED_SYMBOL_NAMES[0]) == Exys::NUM_FIXED_SYMBOLS,
+            "Every fixed symbol needs a name");
+
+    constexpr size_t INITIAL_SLOTS = 1024;
+}
+
+namespace Exys
+{
+
+SymbolTable::SymbolTable()
+: mSlots(INITIAL_SLOTS)
+{
+    // The empty name is NO_SYMBOL and never goes in a slot
+    mNames.push_back(FIXED_SYMBOL_NAMES[0]);
+    for(size_t i = 1; i < NUM_FIXED_SYMBOLS; ++i)
+    {
+        const std::string name = FIXED_SYMBOL_NAMES[i];
+        Insert(name, std::hash<std::string>()(name));
+    }
+}
+
+SymbolTable& SymbolTable::Get()
+{
+    static SymbolTable table;
+    return table;
+}
+
+Symbol SymbolTable::Intern(const std::string& name)
+{
+    if(name.empty()) return NO_SYMBOL;
+
+    const auto hash = std::hash<std::string>()(name);
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto mask = mSlots.size() - 1;
+    for(auto i = hash & mask; mSlots[i].mSymbol != NO_SYMBOL; i = (i + 1) & mask)
+    {
+        const auto& slot = mSlots[i];
+        if(slot.mHash == hash && mNames[slot.mSymbol] == name) return slot.mSymbol;
+    }
+    return Insert(name, hash);
+}
+
+const std::string& SymbolTable::GetName(Symbol symbol) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    assert(symbol < mNames.size());
+    return mNames[symbol];
+}
+
+// Called with the lock held and only for names not in the table
+Symbol SymbolTable::Insert(const std::string& name, size_t hash)
+{
+    if(mNames.size() * 2 >= mSlots.size()) Grow();
+
+    const Symbol symbol = mNames.size();
+    mNames.push_back(name);
+
+    const auto mask = mSlots.size() - 1;
+    auto i = hash & mask;
+    while(mSlots[i].mSymbol != NO_SYMBOL) i = (i + 1) & mask;
+    mSlots[i].mHash = hash;
+    mSlots[i].mSymbol = symbol;
+    return symbol;
+}
+
+void SymbolTable::Grow()
+{
+    std::vector<Slot> slots(mSlots.size() * 2);
+    const auto mask = slots.size() - 1;
+    for(const auto& slot : mSlots)
+    {
+        if(slot.mSymbol == NO_SYMBOL) continue;
+        auto i = slot.mHash & mask;
+        while(slots[i].mSymbol != NO_SYMBOL) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+    mSlots.swap(slots);
+}
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Exys
+{
+
+// Names interned to small dense ids that live as long as the process.
+// Scopes and backends key on these instead of hashing strings
+typedef uint32_t Symbol;
+
+// Keywords and built in procedures get fixed ids so they can be
+// switched on. Names must stay in the same order in symbol.cc
+enum : Symbol
+{
+    NO_SYMBOL,
+    SYMBOL_BEGIN,
+    SYMBOL_DEFINE,
+    SYMBOL_DEFVAR,
+    SYMBOL_SET,
+    SYMBOL_LAMBDA,
+    SYMBOL_INPUT,
+    SYMBOL_INPUT_LIST,
+    SYMBOL_OBSERVE,
+    SYMBOL_PROVIDE,
+    SYMBOL_TERNARY,
+    SYMBOL_ADD,
+    SYMBOL_SUB,
+    SYMBOL_DIV,
+    SYMBOL_MUL,
+    SYMBOL_MOD,
+    SYMBOL_LT,
+    SYMBOL_LE,
+    SYMBOL_GT,
+    SYMBOL_GE,
+    SYMBOL_EQ,
+    SYMBOL_NE,
+    SYMBOL_AND,
+    SYMBOL_OR,
+    SYMBOL_MIN,
+    SYMBOL_MAX,
+    SYMBOL_EXP,
+    SYMBOL_LN,
+    SYMBOL_TRUNC,
+    SYMBOL_NOT,
+    SYMBOL_TICK,
+    SYMBOL_COPY,
+    SYMBOL_LOAD,
+    SYMBOL_STORE,
+    SYMBOL_SIM_APPLY,
+    SYMBOL_ROLLING_SUM,
+    SYMBOL_ROLLING_MEAN,
+    SYMBOL_ROLLING_MIN,
+    SYMBOL_ROLLING_MAX,
+    NUM_FIXED_SYMBOLS
+};
+
+// One per process and safe to use from any thread
+class SymbolTable
+{
+public:
+    static SymbolTable& Get();
+
+    Symbol Intern(const std::string& name);
+    const std::string& GetName(Symbol symbol) const;
+
+private:
+    SymbolTable();
+
+    Symbol Insert(const std::string& name, size_t hash);
+    void Grow();
+
+    // Open addressing with linear probing, kept at most half full.
+    // The hash is kept so most probes never touch the name
+    struct Slot
+    {
+        size_t mHash = 0;
+        Symbol mSymbol = NO_SYMBOL;
+    };
+
+    mutable std::mutex mMutex;
+    std::vector<Slot> mSlots;
+    // Deque so names handed out stay put as more are added
+    std::deque<std::string> mNames;
+};
+
+}
@@ -0,0 +1,61 @@
+#include <fstream>
+#include <sstream>
+
+#include "benchmark/benchmark.h"
+
+#include "exys.h"
+#include "jitwrap.h"
+#include "aotengine.h"
+
+std::string ReadGraph()
+{
+    std::ifstream t(AOT_GRAPH_FILE);
+    std::stringstream buffer;
+    buffer << t.rdbuf();
+    return buffer.str();
+}
+
+std::unique_ptr<Exys::IEngine> BuildJit()
+{
+    return Exys::JitWrap::Build(ReadGraph());
+}
+
+std::unique_ptr<Exys::IEngine> LoadAot()
+{
+    return Exys::AotEngine::Load(AOT_LIBRARY_FILE);
+}
+
+// Time from nothing to an engine ready to take inputs
+template <std::unique_ptr<Exys::IEngine> (*Create)()>
+void BM_Startup(benchmark::State& state)
+{
+    while (state.KeepRunning())
+    {
+        auto engine = Create();
+        benchmark::DoNotOptimize(engine);
+    }
+}
+
+template <std::unique_ptr<Exys::IEngine> (*Create)()>
+void BM_Stabilize(benchmark::State& state)
+{
+    auto engine = Create();
+    auto& prices = engine->LookupInputPoint("prices");
+    engine->LookupInputPoint("gate") = 1.0;
+
+    double adder = 1.0;
+    size_t cur = 0;
+    while (state.KeepRunning())
+    {
+        prices[cur] = ++adder;
+        engine->Stabilize();
+        cur = (cur + 1) % prices.mLength;
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Startup, BuildJit);
+BENCHMARK_TEMPLATE(BM_Startup, LoadAot);
+BENCHMARK_TEMPLATE(BM_Stabilize, BuildJit);
+BENCHMARK_TEMPLATE(BM_Stabilize, LoadAot);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,188 @@
+#include <unistd.h>
+
+#include "benchmark/benchmark.h"
+
+#include "exys.h"
+#include "interpreter.h"
+#include "jitwrap.h"
+#include "jitsession.h"
+#include "jittemplates.h"
+
+// Each input feeds a running sum and has its own observer so the
+// layout grows by roughly three nodes per input
+std::string GetSumChainGraph(int inputs)
+{
+    std::string graph = "(begin ";
+    for(int i = 0; i < inputs; i++)
+    {
+        graph += "(input in" + std::to_string(i) + ") ";
+    }
+    graph += "(define sum0 in0) ";
+    for(int i = 1; i < inputs; i++)
+    {
+        graph += "(define sum" + std::to_string(i) + " (+ sum" + std::to_string(i-1) + 
+            " in" + std::to_string(i) + ")) ";
+        graph += "(observe \"out" + std::to_string(i) + "\" sum" + std::to_string(i) + ") ";
+    }
+    graph += ")";
+    return graph;
+}
+
+// Parsing alone so large generated graphs can be tracked separately
+void BM_Parse_SumChain(benchmark::State& state)
+{
+    const auto graph = GetSumChainGraph(state.range(0));
+    while (state.KeepRunning()) 
+    {
+        auto cell = Exys::Parse(graph);
+        benchmark::DoNotOptimize(cell);
+    }
+    state.SetBytesProcessed(state.iterations() * graph.size());
+}
+
+// Strategies built one after the other that share the standard library.
+// Each file is parsed once per process and built once per graph
+void BM_BuildGraph_Require(benchmark::State& state)
+{
+    std::string graph = "(begin (require \"signals.exys\") (require \"memory.exys\") (input gate) ";
+    for(int i = 0; i < state.range(0); i++)
+    {
+        const auto n = std::to_string(i);
+        graph += "(begin (require \"signals.exys\") (input in" + n + ") "
+                 "(observe \"ema" + n + "\" (std-ema 0.5 gate in" + n + "))) ";
+    }
+    graph += ")";
+    while (state.KeepRunning()) 
+    {
+        auto engine = Exys::Interpreter::Build(graph);
+        benchmark::DoNotOptimize(engine);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Every call of the lambda gets its own scope so this mostly measures
+// what a scope costs to set up
+void BM_BuildGraph_Map(benchmark::State& state)
+{
+    const auto n = std::to_string(state.range(0));
+    const auto graph = "(begin (input-list xs " + n + ") "
+                       "(define sq (lambda (x) (* (+ x 1) (- x 1)))) "
+                       "(observe \"squares\" (map sq xs)) "
+                       "(observe \"sum\" (fold + 0 (map sq xs))))";
+    while (state.KeepRunning()) 
+    {
+        auto engine = Exys::Interpreter::Build(graph);
+        benchmark::DoNotOptimize(engine);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename T> 
+void BM_BuildGraph_SumChain(benchmark::State& state)
+{
+    const auto graph = GetSumChainGraph(state.range(0));
+    while (state.KeepRunning()) 
+    {
+        auto engine = T::Build(graph);
+        benchmark::DoNotOptimize(engine);
+    }
+    state.SetComplexityN(state.range(0));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Warm builds load the object compiled by the first build from the cache
+void BM_BuildGraph_SumChain_JitCache(benchmark::State& state)
+{
+    const auto graph = GetSumChainGraph(state.range(0));
+    const bool warm = state.range(1);
+    const std::string cacheDir = "/tmp/exys-bench-cache-" + std::to_string(getpid());
+    if(warm) Exys::JitWrap::Build(graph, cacheDir);
+
+    int build = 0;
+    while (state.KeepRunning()) 
+    {
+        // Cold builds get a fresh directory every time
+        const auto dir = warm ? cacheDir : cacheDir + "-" + std::to_string(build++);
+        auto engine = Exys::JitWrap::Build(graph, dir);
+        benchmark::DoNotOptimize(engine);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Loading a set of strategies one after the other vs on the session threads
+void BM_BuildGraphs_Serial(benchmark::State& state)
+{
+    const auto graph = GetSumChainGraph(64);
+    while (state.KeepRunning()) 
+    {
+        for(int i = 0; i < state.range(0); ++i)
+        {
+            auto engine = Exys::JitWrap::Build(graph);
+            benchmark::DoNotOptimize(engine);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_BuildGraphs_Session(benchmark::State& state)
+{
+    const auto graph = GetSumChainGraph(64);
+    while (state.KeepRunning()) 
+    {
+        std::vector<std::future<std::unique_ptr<Exys::IEngine>>> builds;
+        for(int i = 0; i < state.range(0); ++i)
+        {
+            builds.push_back(Exys::JitSession::Get().BuildAsync(graph));
+        }
+        for(auto& build : builds)
+        {
+            auto engine = build.get();
+            benchmark::DoNotOptimize(engine);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Many engines of the same graph. The registry compiles it once and
+// every instance after that only copies the points and state
+void BM_ManyEngines_Build(benchmark::State& state)
+{
+    const auto graph = GetSumChainGraph(64);
+    while (state.KeepRunning()) 
+    {
+        std::vector<std::unique_ptr<Exys::IEngine>> engines;
+        for(int i = 0; i < state.range(0); ++i)
+        {
+            engines.push_back(Exys::JitWrap::Build(graph));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_ManyEngines_Registry(benchmark::State& state)
+{
+    const auto graph = GetSumChainGraph(64);
+    while (state.KeepRunning()) 
+    {
+        Exys::JitTemplateRegistry registry;
+        std::vector<std::unique_ptr<Exys::JitWrap>> engines;
+        for(int i = 0; i < state.range(0); ++i)
+        {
+            engines.push_back(registry.Instantiate(graph));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_Parse_SumChain)->RangeMultiplier(8)->Range(64, 262144);
+BENCHMARK(BM_BuildGraph_Require)->Range(1, 64);
+BENCHMARK(BM_BuildGraph_Map)->RangeMultiplier(8)->Range(64, 32768);
+BENCHMARK_TEMPLATE(BM_BuildGraph_SumChain, Exys::Interpreter)->RangeMultiplier(4)->Range(64, 65536)->Complexity();
+BENCHMARK_TEMPLATE(BM_BuildGraph_SumChain, Exys::JitWrap)->RangeMultiplier(4)->Range(64, 1024)->Complexity();
+BENCHMARK(BM_BuildGraph_SumChain_JitCache)->Ranges({{64, 256}, {0, 1}});
+BENCHMARK(BM_BuildGraphs_Serial)->Range(1, 8)->UseRealTime();
+BENCHMARK(BM_BuildGraphs_Session)->Range(1, 8)->UseRealTime();
+BENCHMARK(BM_ManyEngines_Build)->Range(1, 64);
+BENCHMARK(BM_ManyEngines_Registry)->Range(1, 64);
+
+BENCHMARK_MAIN();
@@ -141,10 +141,183 @@ void BM_ExecuteGraph_FatSum(benchmark::State& state)
     }
 }
 
+template <typename T> 
+std::unique_ptr<Exys::IEngine> BuildFatSum(int numInputs, std::vector<std::string>& labels)
+{
+    std::string varins;
+    std::string justnames;
+    for(int i = 0; i < numInputs; i++)
+    {
+        labels.push_back("in" + std::to_string(i));
+        varins += "(input in" + std::to_string(i) + ") ";
+        justnames += " in"+std::to_string(i);
+    }
+    std::string graph = "(begin " + varins + " (observe \"out\" (+ " + justnames + ")))";
+    return T::Build(graph);
+}
+
+// Writing inputs by label hashes the label on every write
+void BM_SetInputs_Label(benchmark::State& state)
+{
+    std::vector<std::string> labels;
+    auto engine = BuildFatSum<Exys::Interpreter>(state.range(0), labels);
+
+    double adder = 1.0;
+    while (state.KeepRunning()) 
+    {
+        ++adder;
+        for(const auto& label : labels)
+        {
+            engine->LookupInputPoint(label) = adder;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * labels.size());
+}
+
+void BM_SetInputs_Handle(benchmark::State& state)
+{
+    std::vector<std::string> labels;
+    auto engine = BuildFatSum<Exys::Interpreter>(state.range(0), labels);
+
+    std::vector<Exys::InputHandle> handles;
+    for(const auto& label : labels)
+    {
+        handles.push_back(engine->ResolveInput(label));
+    }
+    std::vector<double> values(handles.size());
+
+    double adder = 1.0;
+    while (state.KeepRunning()) 
+    {
+        std::fill(values.begin(), values.end(), ++adder);
+        engine->SetInputs(handles.data(), values.data(), handles.size());
+    }
+    state.SetItemsProcessed(state.iterations() * handles.size());
+}
+
+// A burst of updates spread over a handful of inputs. Most of the
+// writes land on an input already written earlier in the burst
+std::vector<Exys::InputUpdate> GetBurst(Exys::IEngine& engine, const std::vector<std::string>& labels, int size)
+{
+    std::vector<Exys::InputUpdate> burst;
+    std::srand(size);
+    for(int i = 0; i < size; ++i)
+    {
+        const auto& label = labels[std::rand() % labels.size()];
+        burst.push_back({engine.ResolveInput(label), double(std::rand() % 100)});
+    }
+    return burst;
+}
+
+template <typename T> 
+void BM_Burst_StabilizePerUpdate(benchmark::State& state)
+{
+    std::vector<std::string> labels;
+    auto engine = BuildFatSum<T>(8, labels);
+    const auto burst = GetBurst(*engine, labels, state.range(0));
+
+    while (state.KeepRunning()) 
+    {
+        for(const auto& update : burst)
+        {
+            engine->SetInput(update.mHandle, update.mVal);
+            engine->Stabilize();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * burst.size());
+}
+
+template <typename T> 
+void BM_Burst_ApplyBatch(benchmark::State& state)
+{
+    std::vector<std::string> labels;
+    auto engine = BuildFatSum<T>(8, labels);
+    const auto burst = GetBurst(*engine, labels, state.range(0));
+
+    while (state.KeepRunning()) 
+    {
+        engine->ApplyBatch(burst.data(), burst.size());
+    }
+    state.SetItemsProcessed(state.iterations() * burst.size());
+}
+
+// Chain of adds so every point recomputes when in0 changes
+std::string GetAddChain(int length)
+{
+    std::string varins;
+    std::string justnames;
+    for(int i = 0; i < length; i++)
+    {
+        varins += "(input in" + std::to_string(i) + ") ";
+        justnames += " in"+std::to_string(i);
+    }
+    return "(begin " + varins + " (observe \"out\" (fold + 0 (list " + justnames + "))))";
+}
+
+// Cost of the per point counters. Second arg switches profiling on
+void BM_Interpreter_Profiling(benchmark::State& state)
+{
+    auto engine = Exys::Interpreter::Build(GetAddChain(state.range(0)));
+    auto& interpreter = static_cast<Exys::Interpreter&>(*engine);
+    interpreter.SetProfiling(state.range(1));
+    auto& input = engine->LookupInputPoint("in0");
+
+    double adder = 1.0;
+    while (state.KeepRunning()) 
+    {
+        input = ++adder;
+        engine->Stabilize();
+    }
+}
+
+// Second arg is the Jitter::ProfileMode compiled in
+void BM_Jit_Profiling(benchmark::State& state)
+{
+    auto mode = static_cast<Exys::Jitter::ProfileMode>(state.range(1));
+    auto engine = Exys::JitWrap::BuildProfiled(GetAddChain(state.range(0)), mode);
+    auto& input = engine->LookupInputPoint("in0");
+
+    double adder = 1.0;
+    while (state.KeepRunning()) 
+    {
+        input = ++adder;
+        engine->Stabilize();
+    }
+}
+
+// Cost of recording engine stats. Second arg switches them on
+template <typename T> 
+void BM_Stabilize_Stats(benchmark::State& state)
+{
+    auto engine = T::Build(GetAddChain(state.range(0)));
+    engine->EnableStats(state.range(1));
+    auto& input = engine->LookupInputPoint("in0");
+
+    double adder = 1.0;
+    while (state.KeepRunning()) 
+    {
+        input = ++adder;
+        engine->Stabilize();
+    }
+}
+
 BENCHMARK_TEMPLATE(BM_ExecuteGraph_FatSum, Exys::JitWrap)->Ranges({{8, 1024}, {0,2}});
 BENCHMARK_TEMPLATE(BM_ExecuteGraph_FatSum, Exys::Interpreter)->Ranges({{8, 1024}, {0,2}});
 
 BENCHMARK_TEMPLATE(BM_ExecuteGraph_DeepSum, Exys::JitWrap)->Ranges({{8, 1024}, {0,2}});
 BENCHMARK_TEMPLATE(BM_ExecuteGraph_DeepSum, Exys::Interpreter)->Ranges({{8, 1024}, {0,2}});
 
+BENCHMARK(BM_SetInputs_Label)->Range(8, 1024);
+BENCHMARK(BM_SetInputs_Handle)->Range(8, 1024);
+
+BENCHMARK(BM_Interpreter_Profiling)->Ranges({{8, 1024}, {0, 1}});
+BENCHMARK(BM_Jit_Profiling)->Ranges({{8, 512}, {0, 2}});
+BENCHMARK_TEMPLATE(BM_Stabilize_Stats, Exys::JitWrap)->Ranges({{8, 512}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_Stabilize_Stats, Exys::Interpreter)->Ranges({{8, 512}, {0, 1}});
+
+BENCHMARK_TEMPLATE(BM_Burst_StabilizePerUpdate, Exys::JitWrap)->Range(8, 256);
+BENCHMARK_TEMPLATE(BM_Burst_StabilizePerUpdate, Exys::Interpreter)->Range(8, 256);
+BENCHMARK_TEMPLATE(BM_Burst_ApplyBatch, Exys::JitWrap)->Range(8, 256);
+BENCHMARK_TEMPLATE(BM_Burst_ApplyBatch, Exys::Interpreter)->Range(8, 256);
+
 BENCHMARK_MAIN()
@@ -0,0 +1,81 @@
+#include "benchmark/benchmark.h"
+
+#include "exys.h"
+#include "jitwrap.h"
+#include "jitmulti.h"
+
+const std::string PRICING_GRAPH = 
+    "(begin"
+    "    (input spot)"
+    "    (input strike)"
+    "    (input vol)"
+    "    (input rate)"
+    "    (define intrinsic (max (- spot strike) 0))"
+    "    (define forward (* spot (+ 1 rate)))"
+    "    (observe \"value\" (+ intrinsic (* vol forward 0.4)))"
+    "    (observe \"itm\" (? (> spot strike) 1 0)))";
+
+const char* PRICING_INPUTS[] = {"spot", "strike", "vol", "rate"};
+
+double GetInstanceInput(size_t instance, size_t input)
+{
+    return 100.0 + ((instance * 7 + input * 13) % 41) - 20.0;
+}
+
+// One engine per instance each stabilized in turn
+void BM_Instances_JitWrap(benchmark::State& state)
+{
+    const size_t numInstances = state.range(0);
+    auto engine = Exys::JitWrap::Build(PRICING_GRAPH);
+    auto& base = static_cast<Exys::JitWrap&>(*engine);
+
+    std::vector<std::unique_ptr<Exys::JitWrap>> instances;
+    std::vector<Exys::InputHandle> handles;
+    for(auto* label : PRICING_INPUTS) handles.push_back(engine->ResolveInput(label));
+    for(size_t i = 0; i < numInstances; ++i) instances.emplace_back(new Exys::JitWrap(base));
+
+    double bump = 0.0;
+    while (state.KeepRunning()) 
+    {
+        bump += 0.01;
+        for(size_t i = 0; i < numInstances; ++i)
+        {
+            for(size_t in = 0; in < handles.size(); ++in)
+            {
+                instances[i]->SetInput(handles[in], GetInstanceInput(i, in) + bump);
+            }
+            instances[i]->Stabilize();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * numInstances);
+}
+
+void BM_Instances_JitMulti(benchmark::State& state)
+{
+    const size_t numInstances = state.range(0);
+    auto engine = Exys::JitMulti::Build(PRICING_GRAPH, numInstances);
+
+    std::vector<Exys::InputHandle> handles;
+    for(auto* label : PRICING_INPUTS) handles.push_back(engine->ResolveInput(label));
+
+    double bump = 0.0;
+    while (state.KeepRunning()) 
+    {
+        bump += 0.01;
+        for(size_t in = 0; in < handles.size(); ++in)
+        {
+            auto* column = engine->GetInputColumn(handles[in]);
+            for(size_t i = 0; i < numInstances; ++i)
+            {
+                column[i] = GetInstanceInput(i, in) + bump;
+            }
+        }
+        engine->Stabilize();
+    }
+    state.SetItemsProcessed(state.iterations() * numInstances);
+}
+
+BENCHMARK(BM_Instances_JitWrap)->RangeMultiplier(4)->Range(16, 16384);
+BENCHMARK(BM_Instances_JitMulti)->RangeMultiplier(4)->Range(16, 16384);
+
+BENCHMARK_MAIN();
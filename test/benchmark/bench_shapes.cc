@@ -0,0 +1,272 @@
+#include <fstream>
+#include <sstream>
+
+#include "benchmark/benchmark.h"
+
+#include "exys.h"
+#include "interpreter.h"
+#include "jitwrap.h"
+#include "allocations.h"
+
+bool ReadExample(benchmark::State& state, const std::string& name, std::string& graph)
+{
+    std::ifstream t(std::string(EXAMPLES_DIR) + "/" + name);
+    if(!t.good())
+    {
+        state.SkipWithError(("Failed to open " + name).c_str());
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << t.rdbuf();
+    graph = buffer.str();
+    return true;
+}
+
+// Writes one element of one input per step, walking every element of
+// every input in turn. Members of input lists are reached through the
+// list so their own labels are skipped
+class InputDriver
+{
+public:
+    InputDriver(Exys::IEngine& engine)
+    {
+        for(const auto& label : engine.GetInputPointLabels())
+        {
+            if(label.find('[') == std::string::npos) mInputs.push_back(&engine.LookupInputPoint(label));
+        }
+    }
+
+    void Step(uint64_t step)
+    {
+        auto& input = *mInputs[step % mInputs.size()];
+        const auto element = (step / mInputs.size()) % input.mLength;
+        input[element] = 1.0 + step % 97;
+    }
+
+private:
+    std::vector<Exys::Point*> mInputs;
+};
+
+// Mean points the interpreter recomputes per step of the driver. The
+// generated code can't count them so both engines report this
+uint64_t GetNodesPerStabilize(const std::string& graph)
+{
+    auto engine = Exys::Interpreter::Build(graph);
+    InputDriver driver(*engine);
+    engine->EnableStats(true);
+    for(uint64_t step = 0; step < 1024; ++step)
+    {
+        driver.Step(step);
+        engine->Stabilize();
+    }
+    return engine->GetStats().mNodesRecomputed.mMean;
+}
+
+void SetCounters(benchmark::State& state, uint64_t nodesPerIteration, uint64_t allocations)
+{
+    state.counters["nodes/s"] = benchmark::Counter(state.iterations() * nodesPerIteration,
+            benchmark::Counter::kIsRate);
+    state.counters["allocs/iter"] = double(allocations) / state.iterations();
+}
+
+template <typename T>
+void RunStabilize(benchmark::State& state, const std::string& graph)
+{
+    std::unique_ptr<Exys::IEngine> engine;
+    try
+    {
+        engine = T::Build(graph);
+    }
+    catch(const Exys::GraphBuildException& e)
+    {
+        state.SkipWithError(e.GetErrorMessage(graph).c_str());
+        return;
+    }
+    const auto nodes = GetNodesPerStabilize(graph);
+    InputDriver driver(*engine);
+
+    uint64_t step = 0;
+    const auto allocations = GetAllocationCount();
+    while (state.KeepRunning())
+    {
+        driver.Step(step++);
+        engine->Stabilize();
+    }
+    SetCounters(state, nodes, GetAllocationCount() - allocations);
+}
+
+// One input read by every observer
+std::string GetWideFanOut(int width)
+{
+    std::string graph = "(begin (input in) ";
+    for(int i = 0; i < width; i++)
+    {
+        graph += "(observe \"out" + std::to_string(i) + "\" (* in " + std::to_string(i + 1) + ")) ";
+    }
+    return graph + ")";
+}
+
+// Every level splits in two and joins again so each point is
+// reached down two paths
+std::string GetDiamonds(int depth)
+{
+    std::string graph = "(begin (input in) (define level0 in) ";
+    for(int i = 1; i <= depth; i++)
+    {
+        const auto prev = "level" + std::to_string(i - 1);
+        graph += "(define level" + std::to_string(i) + " (+ (* " + prev + " 0.5) (- " + prev + " 1))) ";
+    }
+    return graph + "(observe \"out\" level" + std::to_string(depth) + "))";
+}
+
+// Accumulators, moving averages and value stores so most of the
+// graph reads and writes state
+std::string GetStateful(int count)
+{
+    std::string graph = "(begin (require \"signals.exys\") (require \"memory.exys\") (input gate) ";
+    for(int i = 0; i < count; i++)
+    {
+        const auto n = std::to_string(i);
+        graph += "(input in" + n + ") "
+                 "(defvar acc" + n + " 0) "
+                 "(set! acc" + n + " (+ acc" + n + " in" + n + ")) "
+                 "(observe \"acc" + n + "\" acc" + n + ") "
+                 "(observe \"ema" + n + "\" (std-ema 0.5 gate in" + n + ")) "
+                 "(observe \"max" + n + "\" (apply max (std-value-store 4 gate in" + n + "))) ";
+    }
+    return graph + ")";
+}
+
+// The max of the last size values, kept by a chain of flip flops
+// and by the built in window
+std::string GetValueStoreMax(int size)
+{
+    return "(begin (require \"memory.exys\") (input gate) (input in) "
+           "(observe \"max\" (apply max (std-value-store " + std::to_string(size) + " gate in))))";
+}
+
+std::string GetRollingMax(int size)
+{
+    return "(begin (input gate) (input in) "
+           "(observe \"max\" (rolling-max " + std::to_string(size) + " gate in)))";
+}
+
+// A two sided book of price and volume levels
+std::string GetBookSignals(int levels)
+{
+    return "(input-list book 2 " + std::to_string(levels) + " 2) "
+           "(define bids (car book)) "
+           "(define asks (car (cdr book))) "
+           "(define volume (lambda (side) (fold + 0 (map (lambda (level) (nth 1 level)) side)))) "
+           "(define notional (lambda (side) (fold + 0 (map (lambda (level) (* (nth 0 level) (nth 1 level))) side)))) "
+           "(observe \"bidVwap\" (/ (notional bids) (volume bids))) "
+           "(observe \"askVwap\" (/ (notional asks) (volume asks))) ";
+}
+
+std::string GetBook(int levels)
+{
+    return "(begin " + GetBookSignals(levels) + ")";
+}
+
+template <typename T, std::string (*GetGraph)(int)>
+void BM_Stabilize(benchmark::State& state)
+{
+    RunStabilize<T>(state, GetGraph(state.range(0)));
+}
+
+void BM_Stabilize_Example_Jit(benchmark::State& state, const char* name)
+{
+    std::string graph;
+    if(ReadExample(state, name, graph)) RunStabilize<Exys::JitWrap>(state, graph);
+}
+
+void BM_Stabilize_Example_Interpreter(benchmark::State& state, const char* name)
+{
+    std::string graph;
+    if(ReadExample(state, name, graph)) RunStabilize<Exys::Interpreter>(state, graph);
+}
+
+template <typename T>
+void RunBuild(benchmark::State& state, const std::string& graph)
+{
+    const auto allocations = GetAllocationCount();
+    while (state.KeepRunning())
+    {
+        auto engine = T::Build(graph);
+        benchmark::DoNotOptimize(engine);
+    }
+    state.counters["allocs/iter"] = double(GetAllocationCount() - allocations) / state.iterations();
+}
+
+template <typename T, std::string (*GetGraph)(int)>
+void BM_Build(benchmark::State& state)
+{
+    RunBuild<T>(state, GetGraph(state.range(0)));
+}
+
+void BM_Build_Example_Jit(benchmark::State& state, const char* name)
+{
+    std::string graph;
+    if(ReadExample(state, name, graph)) RunBuild<Exys::JitWrap>(state, graph);
+}
+
+void BM_Build_Example_Interpreter(benchmark::State& state, const char* name)
+{
+    std::string graph;
+    if(ReadExample(state, name, graph)) RunBuild<Exys::Interpreter>(state, graph);
+}
+
+// Each iteration runs one simulation to completion from the captured
+// state. Steps are counted as the number of them depends on the graph
+void BM_Simulation(benchmark::State& state)
+{
+    const auto graph = "(begin (input price) (input limit) " + GetBookSignals(state.range(0)) +
+                       "(observe \"value\" (* price (volume bids))) "
+                       "(sim-apply price (+ price 0.5) (>= price limit)))";
+    auto engine = Exys::JitWrap::Build(graph);
+    engine->SetInput(engine->ResolveInput("price"), 1.0);
+    engine->SetInput(engine->ResolveInput("limit"), 33.0);
+    engine->Stabilize();
+    engine->CaptureState();
+
+    uint64_t steps = 0;
+    const auto allocations = GetAllocationCount();
+    while (state.KeepRunning())
+    {
+        engine->ResetState();
+        for(int step = 0; step < 1000 && !engine->RunSimulationId(0); ++step) ++steps;
+    }
+    state.counters["steps/s"] = benchmark::Counter(steps, benchmark::Counter::kIsRate);
+    state.counters["allocs/iter"] = double(GetAllocationCount() - allocations) / state.iterations();
+}
+
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::JitWrap, GetWideFanOut)->Range(8, 1024);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::Interpreter, GetWideFanOut)->Range(8, 1024);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::JitWrap, GetDiamonds)->Range(8, 512);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::Interpreter, GetDiamonds)->Range(8, 512);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::JitWrap, GetStateful)->Range(1, 64);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::Interpreter, GetStateful)->Range(1, 64);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::JitWrap, GetBook)->Range(4, 64);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::Interpreter, GetBook)->Range(4, 64);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::JitWrap, GetValueStoreMax)->Range(16, 1024);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::Interpreter, GetValueStoreMax)->Range(16, 1024);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::JitWrap, GetRollingMax)->Range(16, 1024);
+BENCHMARK_TEMPLATE(BM_Stabilize, Exys::Interpreter, GetRollingMax)->Range(16, 1024);
+
+BENCHMARK_CAPTURE(BM_Stabilize_Example_Jit, booksolve, "booksolve.exys");
+BENCHMARK_CAPTURE(BM_Stabilize_Example_Interpreter, booksolve, "booksolve.exys");
+BENCHMARK_CAPTURE(BM_Stabilize_Example_Jit, mindelta, "mindelta.exys");
+BENCHMARK_CAPTURE(BM_Stabilize_Example_Interpreter, mindelta, "mindelta.exys");
+BENCHMARK_CAPTURE(BM_Stabilize_Example_Jit, signals, "signals.exys");
+BENCHMARK_CAPTURE(BM_Stabilize_Example_Interpreter, signals, "signals.exys");
+
+BENCHMARK(BM_Simulation)->Range(4, 64);
+
+BENCHMARK_TEMPLATE(BM_Build, Exys::JitWrap, GetWideFanOut)->Range(8, 1024);
+BENCHMARK_TEMPLATE(BM_Build, Exys::Interpreter, GetWideFanOut)->Range(8, 1024);
+BENCHMARK_TEMPLATE(BM_Build, Exys::JitWrap, GetStateful)->Range(1, 64);
+BENCHMARK_TEMPLATE(BM_Build, Exys::Interpreter, GetStateful)->Range(1, 64);
+BENCHMARK_CAPTURE(BM_Build_Example_Jit, mindelta, "mindelta.exys");
+BENCHMARK_CAPTURE(BM_Build_Example_Interpreter, mindelta, "mindelta.exys");
+
+BENCHMARK_MAIN()
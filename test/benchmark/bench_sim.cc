@@ -0,0 +1,92 @@
+#include <thread>
+
+#include "benchmark/benchmark.h"
+
+#include "exys.h"
+#include "jitwrap.h"
+#include "simulationpool.h"
+
+// Each simulation walks price up a tick at a time until it crosses
+// the limit so jobs take a varying number of steps
+const std::string SWEEP_GRAPH = 
+    "(begin"
+    "    (input price)"
+    "    (input limit)"
+    "    (input-list book 8)"
+    "    (define depth (fold + 0 book))"
+    "    (observe \"value\" (* depth (- limit price)))"
+    "    (observe price)"
+    "    (sim-apply price (+ price 0.5) (>= price limit)))";
+
+std::vector<Exys::SimulationJob> GetSweepJobs(Exys::IEngine& engine, size_t numJobs)
+{
+    std::vector<Exys::SimulationJob> jobs(numJobs);
+    const auto limit = engine.ResolveInput("limit");
+    for(size_t i = 0; i < numJobs; ++i)
+    {
+        jobs[i].mSimId = 0;
+        jobs[i].mInputs.push_back({limit, 10.0 + (i % 64)});
+    }
+    return jobs;
+}
+
+std::unique_ptr<Exys::IEngine> BuildSweepEngine()
+{
+    auto engine = Exys::JitWrap::Build(SWEEP_GRAPH);
+    engine->SetInput(engine->ResolveInput("price"), 1.0);
+    engine->Stabilize();
+    engine->CaptureState();
+    return engine;
+}
+
+void BM_Sweep_Serial(benchmark::State& state)
+{
+    auto engine = BuildSweepEngine();
+    const auto jobs = GetSweepJobs(*engine, state.range(0));
+    const auto value = engine->ResolveObserver("value");
+
+    double total = 0.0;
+    while (state.KeepRunning()) 
+    {
+        for(const auto& job : jobs)
+        {
+            engine->ResetState();
+            for(const auto& update : job.mInputs)
+            {
+                engine->SetInput(update.mHandle, update.mVal);
+            }
+            engine->Stabilize();
+            for(int step = 0; step < 1000 && !engine->RunSimulationId(job.mSimId); ++step) {}
+            engine->Stabilize();
+            total += engine->ReadObserver(value);
+        }
+    }
+    benchmark::DoNotOptimize(total);
+    state.SetItemsProcessed(state.iterations() * jobs.size());
+}
+
+void BM_Sweep_Pool(benchmark::State& state)
+{
+    auto engine = BuildSweepEngine();
+    const auto jobs = GetSweepJobs(*engine, state.range(0));
+    std::vector<Exys::ObserverHandle> observers;
+    observers.push_back(engine->ResolveObserver("value"));
+
+    Exys::SimulationPool pool(static_cast<Exys::JitWrap&>(*engine), std::thread::hardware_concurrency());
+
+    double total = 0.0;
+    while (state.KeepRunning()) 
+    {
+        for(const auto& result : pool.Run(jobs, observers))
+        {
+            total += result.mObservers[0];
+        }
+    }
+    benchmark::DoNotOptimize(total);
+    state.SetItemsProcessed(state.iterations() * jobs.size());
+}
+
+BENCHMARK(BM_Sweep_Serial)->RangeMultiplier(4)->Range(16, 4096)->UseRealTime();
+BENCHMARK(BM_Sweep_Pool)->RangeMultiplier(4)->Range(16, 4096)->UseRealTime();
+
+BENCHMARK_MAIN();
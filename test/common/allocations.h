@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// Linking this in replaces the global operator new and delete with
+// ones that count every allocation the process makes
+uint64_t GetAllocationCount();
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+
+#include "enginestats.h"
+
+namespace Exys {
+namespace test {
+
+const uint64_t MAX_VALUE = (uint64_t(1) << StatsHistogram::MAX_VALUE_BITS) - 1;
+
+TEST(StatsHistogram, SmallValuesGetABucketEach)
+{
+    for(uint64_t value = 0; value < StatsHistogram::SUB_BUCKETS; ++value)
+    {
+        ASSERT_EQ(StatsHistogram::GetBucket(value), value);
+        ASSERT_EQ(StatsHistogram::GetBucketTop(value), value);
+    }
+}
+
+TEST(StatsHistogram, PowersOfTwo)
+{
+    // First sub bucket above 32 is still a single value wide
+    ASSERT_EQ(StatsHistogram::GetBucket(32), 32u);
+    ASSERT_EQ(StatsHistogram::GetBucketTop(32), 32u);
+    ASSERT_EQ(StatsHistogram::GetBucket(63), 63u);
+    ASSERT_EQ(StatsHistogram::GetBucket(64), 64u);
+    ASSERT_EQ(StatsHistogram::GetBucket(65), 64u);
+    ASSERT_EQ(StatsHistogram::GetBucketTop(64), 65u);
+
+    // Each power of two starts a run of 32 buckets and the value
+    // just below it is the top of the last bucket of the run before
+    for(int bit = StatsHistogram::SUB_BUCKET_BITS + 1; bit < StatsHistogram::MAX_VALUE_BITS; ++bit)
+    {
+        const uint64_t power = uint64_t(1) << bit;
+        const auto bucket = StatsHistogram::GetBucket(power);
+        ASSERT_EQ(bucket, size_t(StatsHistogram::SUB_BUCKETS * (bit - StatsHistogram::SUB_BUCKET_BITS + 1)));
+        ASSERT_EQ(StatsHistogram::GetBucket(power - 1), bucket - 1);
+        ASSERT_EQ(StatsHistogram::GetBucketTop(bucket - 1), power - 1);
+        ASSERT_EQ(StatsHistogram::GetBucketTop(bucket), power + (power >> StatsHistogram::SUB_BUCKET_BITS) - 1);
+    }
+}
+
+TEST(StatsHistogram, LargeValuesAreClamped)
+{
+    const size_t last = StatsHistogram::NUM_BUCKETS - 1;
+    ASSERT_EQ(StatsHistogram::GetBucket(MAX_VALUE), last);
+    ASSERT_EQ(StatsHistogram::GetBucket(MAX_VALUE + 1), last);
+    ASSERT_EQ(StatsHistogram::GetBucket(std::numeric_limits<uint64_t>::max()), last);
+    ASSERT_EQ(StatsHistogram::GetBucketTop(last), MAX_VALUE);
+}
+
+// A bucket's top is the largest value that lands in it and is never
+// more than 1/32 above the smallest
+TEST(StatsHistogram, BucketsCoverEveryValue)
+{
+    for(uint64_t value = 1; value < MAX_VALUE; value += 1 + value / 7)
+    {
+        const auto bucket = StatsHistogram::GetBucket(value);
+        const auto top = StatsHistogram::GetBucketTop(bucket);
+        const auto bottom = StatsHistogram::GetBucketTop(bucket - 1) + 1;
+        ASSERT_LE(bottom, value);
+        ASSERT_GE(top, value);
+        ASSERT_EQ(StatsHistogram::GetBucket(bottom), bucket);
+        ASSERT_EQ(StatsHistogram::GetBucket(top), bucket);
+        ASSERT_LE(top - bottom, bottom / StatsHistogram::SUB_BUCKETS);
+    }
+}
+
+TEST(StatsHistogram, EmptySummary)
+{
+    StatsHistogram histogram;
+    const auto summary = histogram.GetSummary();
+    ASSERT_EQ(summary.mCount, 0u);
+    ASSERT_EQ(summary.mMax, 0u);
+    ASSERT_EQ(summary.mP50, 0u);
+}
+
+TEST(StatsHistogram, PercentilesOfOneToHundred)
+{
+    StatsHistogram histogram;
+    for(uint64_t value = 100; value > 0; --value) histogram.Record(value);
+
+    // Below 64 buckets are exact, above they are two wide
+    // and report their top. Nothing goes past the max
+    const auto summary = histogram.GetSummary();
+    ASSERT_EQ(summary.mCount, 100u);
+    ASSERT_EQ(summary.mMin, 1u);
+    ASSERT_EQ(summary.mMax, 100u);
+    ASSERT_EQ(summary.mMean, 50u);
+    ASSERT_EQ(summary.mP50, 50u);
+    ASSERT_EQ(summary.mP90, 91u);
+    ASSERT_EQ(summary.mP99, 99u);
+    ASSERT_EQ(summary.mP999, 100u);
+}
+
+TEST(StatsHistogram, PercentilesOfSkewedValues)
+{
+    // 990 fast and 10 slow so only the tail sees the slow ones
+    StatsHistogram histogram;
+    for(int i = 0; i < 990; ++i) histogram.Record(10);
+    for(int i = 0; i < 10; ++i) histogram.Record(1000000);
+
+    const auto summary = histogram.GetSummary();
+    ASSERT_EQ(summary.mP50, 10u);
+    ASSERT_EQ(summary.mP90, 10u);
+    ASSERT_EQ(summary.mP99, 10u);
+    ASSERT_EQ(summary.mP999, 1000000u);
+    ASSERT_EQ(summary.mMean, (990u * 10 + 10u * 1000000) / 1000);
+}
+
+TEST(StatsHistogram, SingleValue)
+{
+    StatsHistogram histogram;
+    histogram.Record(1000);
+    const auto summary = histogram.GetSummary();
+    ASSERT_EQ(summary.mMin, 1000u);
+    ASSERT_EQ(summary.mP50, 1000u);
+    ASSERT_EQ(summary.mP999, 1000u);
+
+    histogram.Reset();
+    ASSERT_EQ(histogram.GetSummary().mCount, 0u);
+    histogram.Record(0);
+    ASSERT_EQ(histogram.GetSummary().mMin, 0u);
+    ASSERT_EQ(histogram.GetSummary().mP50, 0u);
+}
+
+}}
@@ -0,0 +1,166 @@
+#ifdef EXYS_JIT
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jitwrap.h"
+
+namespace Exys {
+namespace test {
+
+const char* CACHE_GRAPH = R"((begin
+    (input a)
+    (input b)
+    (input-list xs 4)
+    (defvar total 0)
+    (define last total)
+    (set! total (+ last a))
+    (observe "total" total)
+    (observe "mix" (? (> a b) (* a (car xs)) (- b (nth 3 xs))))
+    (observe "sum" (fold + 0 xs))
+))";
+
+typedef std::vector<std::vector<std::pair<std::string, double>>> GraphRun;
+
+// Observers after each of a run of batches
+GraphRun RunGraph(IEngine& engine)
+{
+    GraphRun ret;
+    const InputUpdate updates[] = {
+        {engine.ResolveInput("a"), 0.0}, {engine.ResolveInput("b"), 0.0},
+        {engine.ResolveInput("xs[0]"), 0.0}, {engine.ResolveInput("xs[3]"), 0.0}};
+    for(int step = 0; step < 20; ++step)
+    {
+        std::vector<InputUpdate> batch(std::begin(updates), std::end(updates));
+        for(size_t i = 0; i < batch.size(); ++i) batch[i].mVal = (step * 3 + i * 5) % 7 - 2.5;
+        engine.ApplyBatch(batch.data(), batch.size());
+        auto observers = engine.DumpObservers();
+        std::sort(observers.begin(), observers.end());
+        ret.push_back(observers);
+    }
+    return ret;
+}
+
+// Each test gets an empty directory removed again at the end
+class JitCache : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        char pattern[] = "/tmp/exys-jitcache-XXXXXX";
+        ASSERT_TRUE(mkdtemp(pattern));
+        mDirectory = pattern;
+    }
+
+    void TearDown() override
+    {
+        for(const auto& file : GetFiles()) std::remove((mDirectory + "/" + file).c_str());
+        rmdir(mDirectory.c_str());
+    }
+
+    std::vector<std::string> GetFiles() const
+    {
+        std::vector<std::string> files;
+        if(DIR* dir = opendir(mDirectory.c_str()))
+        {
+            while(dirent* entry = readdir(dir))
+            {
+                const std::string name = entry->d_name;
+                if(name != "." && name != "..") files.push_back(name);
+            }
+            closedir(dir);
+        }
+        return files;
+    }
+
+    // The one object in the cache
+    std::string GetObjectPath() const
+    {
+        std::vector<std::string> objects;
+        for(const auto& file : GetFiles())
+        {
+            if(file.size() > 2 && file.compare(file.size() - 2, 2, ".o") == 0) objects.push_back(file);
+        }
+        EXPECT_EQ(objects.size(), 1u);
+        return objects.empty() ? "" : mDirectory + "/" + objects[0];
+    }
+
+    std::string ReadObject() const
+    {
+        std::ifstream object(GetObjectPath(), std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(object), std::istreambuf_iterator<char>());
+    }
+
+    // Objects are written to a new file and renamed over the old one
+    // so the link made here is only kept if the object is loaded
+    // from the cache rather than compiled and written again
+    void ExpectWarmStart(const GraphRun& expected) const;
+
+    std::string mDirectory;
+};
+
+void JitCache::ExpectWarmStart(const GraphRun& expected) const
+{
+    const auto linked = mDirectory + "/linked";
+    ASSERT_EQ(link(GetObjectPath().c_str(), linked.c_str()), 0);
+    ASSERT_EQ(expected, RunGraph(*JitWrap::Build(CACHE_GRAPH, mDirectory)));
+    ASSERT_EQ(expected, RunGraph(*JitWrap::Build(CACHE_GRAPH, mDirectory)));
+
+    struct stat info;
+    ASSERT_EQ(stat(GetObjectPath().c_str(), &info), 0);
+    ASSERT_EQ(info.st_nlink, 2u);
+    ASSERT_EQ(unlink(linked.c_str()), 0);
+}
+
+TEST_F(JitCache, WarmStartMatchesColdCompile)
+{
+    const auto uncached = RunGraph(*JitWrap::Build(CACHE_GRAPH));
+    ASSERT_EQ(uncached, RunGraph(*JitWrap::Build(CACHE_GRAPH, mDirectory)));
+    ExpectWarmStart(uncached);
+}
+
+// Compiling the same module gives the same object so a damaged one
+// has to be replaced by exactly what the cold compile wrote. Anything
+// else means it was rewritten without being optimised
+TEST_F(JitCache, CorruptObjectIsCompiledAgain)
+{
+    const auto cold = RunGraph(*JitWrap::Build(CACHE_GRAPH, mDirectory));
+    const auto optimised = ReadObject();
+    const auto size = optimised.size();
+    {
+        std::fstream object(GetObjectPath(), std::ios::in | std::ios::out | std::ios::binary);
+        object.seekp(size / 2);
+        const char junk[] = "not an object file";
+        object.write(junk, sizeof(junk));
+    }
+    const auto corrupt = ReadObject();
+
+    ASSERT_EQ(cold, RunGraph(*JitWrap::Build(CACHE_GRAPH, mDirectory)));
+    ASSERT_NE(ReadObject(), corrupt);
+    ASSERT_EQ(ReadObject(), optimised);
+    ExpectWarmStart(cold);
+}
+
+TEST_F(JitCache, TruncatedObjectIsCompiledAgain)
+{
+    const auto cold = RunGraph(*JitWrap::Build(CACHE_GRAPH, mDirectory));
+    const auto optimised = ReadObject();
+    const auto size = optimised.size();
+    for(const size_t length : {size_t(0), size_t(7), size / 2, size - 1})
+    {
+        ASSERT_EQ(truncate(GetObjectPath().c_str(), length), 0);
+        ASSERT_EQ(cold, RunGraph(*JitWrap::Build(CACHE_GRAPH, mDirectory)));
+        ASSERT_EQ(ReadObject(), optimised);
+        ExpectWarmStart(cold);
+    }
+}
+
+}}
+#endif
@@ -0,0 +1,117 @@
+#ifdef EXYS_JIT
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "jitwrap.h"
+#include "jitmulti.h"
+
+namespace Exys {
+namespace test {
+
+const char* STATEFUL_GRAPH = R"((begin
+    (input a)
+    (input b)
+    (input-list xs 3)
+    (defvar total 0)
+    (define last total)
+    (set! total (+ last (* a b)))
+    (observe "total" total)
+    (observe "pick" (? (> a b) (car xs) (nth 2 xs)))
+    (observe "sum" (fold + 0 xs))
+    (observe "spread" (- (max a b) (min (car xs) (nth 1 xs))))
+))";
+
+const char* ROLLING_GRAPH = R"((begin
+    (input val)
+    (input gate)
+    (observe "sum" (rolling-sum 3 gate val))
+    (observe "mean" (rolling-mean 3 gate val))
+    (observe "min" (rolling-min 4 gate val))
+    (observe "max" (rolling-max 2 gate val))
+))";
+
+// Runs each instance of a multi engine next to a copy of a plain
+// engine fed the same inputs and checks every observer after each
+// stabilize. Values are drawn from a small range so inputs often
+// stay the same from one step to the next
+void ExpectSameAsJitWrap(const char* text, size_t numInstances, int steps)
+{
+    auto multi = JitMulti::Build(text, numInstances);
+    auto built = JitWrap::Build(text);
+    auto& base = static_cast<JitWrap&>(*built);
+    std::vector<std::unique_ptr<JitWrap>> engines;
+    for(size_t i = 0; i < numInstances; ++i) engines.emplace_back(new JitWrap(base));
+
+    std::mt19937 rng(numInstances);
+    std::uniform_int_distribution<int> values(-4, 4);
+    for(int step = 0; step < steps; ++step)
+    {
+        for(const auto& label : base.GetInputPointLabels())
+        {
+            const auto handle = multi->ResolveInput(label);
+            ASSERT_TRUE(handle.IsValid()) << label;
+            auto* column = multi->GetInputColumn(handle);
+            for(size_t i = 0; i < numInstances; ++i)
+            {
+                auto& point = engines[i]->LookupInputPoint(label);
+                for(uint32_t k = 0; k < point.mLength; ++k)
+                {
+                    const double value = values(rng) / 2.0;
+                    point[k] = value;
+                    column[k * numInstances + i] = value;
+                }
+            }
+        }
+        multi->Stabilize();
+        for(auto& engine : engines) engine->Stabilize();
+
+        for(const auto& label : base.GetObserverPointLabels())
+        {
+            const auto handle = multi->ResolveObserver(label);
+            ASSERT_TRUE(handle.IsValid()) << label;
+            const auto* column = multi->GetObserverColumn(handle);
+            for(size_t i = 0; i < numInstances; ++i)
+            {
+                auto& point = engines[i]->LookupObserverPoint(label);
+                for(uint32_t k = 0; k < point.mLength; ++k)
+                {
+                    const double expected = point[k].mVal;
+                    const double actual = column[k * numInstances + i];
+                    if(std::isnan(expected))
+                    {
+                        ASSERT_TRUE(std::isnan(actual)) << label << " instance " << i << " step " << step;
+                    }
+                    else
+                    {
+                        ASSERT_DOUBLE_EQ(expected, actual) << label << " instance " << i << " step " << step;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(JitMulti, StatefulMatchesJitWrap)
+{
+    ExpectSameAsJitWrap(STATEFUL_GRAPH, 37, 50);
+}
+
+TEST(JitMulti, RollingMatchesJitWrap)
+{
+    ExpectSameAsJitWrap(ROLLING_GRAPH, 37, 50);
+}
+
+// Counts that don't fill a whole vector
+TEST(JitMulti, OddInstanceCounts)
+{
+    for(size_t numInstances : {1, 3, 5, 17})
+    {
+        ExpectSameAsJitWrap(STATEFUL_GRAPH, numInstances, 10);
+        ExpectSameAsJitWrap(ROLLING_GRAPH, numInstances, 10);
+    }
+}
+
+}}
+#endif
@@ -0,0 +1,113 @@
+#ifdef EXYS_JIT
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "jitsession.h"
+
+namespace Exys {
+namespace test {
+
+std::string GetAddGraph(int constant)
+{
+    return "(begin (input a) (observe \"out\" (+ a " + std::to_string(constant) + ")))";
+}
+
+TEST(JitSession, BuildAsync)
+{
+    JitSession session(2);
+    std::vector<std::future<std::unique_ptr<IEngine>>> builds;
+    for(int i = 0; i < 8; ++i) builds.push_back(session.BuildAsync(GetAddGraph(i)));
+    for(int i = 0; i < 8; ++i)
+    {
+        auto engine = builds[i].get();
+        engine->SetInput(engine->ResolveInput("a"), 1.0);
+        engine->Stabilize();
+        ASSERT_EQ(engine->ReadObserver(engine->ResolveObserver("out")), 1.0 + i);
+    }
+}
+
+TEST(JitSession, BuildErrorsReachTheFuture)
+{
+    JitSession session(1);
+    auto build = session.BuildAsync("(begin (observe \"x\" (nope 1)))");
+    ASSERT_THROW(build.get(), GraphBuildException);
+}
+
+// One thread held up by the first job so the rest are still queued
+// when the session is destroyed. They have to run rather than leave
+// their futures broken
+TEST(JitSession, QueuedBuildsFinishOnShutdown)
+{
+    std::promise<void> release;
+    std::vector<std::future<std::unique_ptr<IEngine>>> builds;
+    {
+        std::unique_ptr<JitSession> session(new JitSession(1));
+        auto released = release.get_future().share();
+        session->Post([released] { released.wait(); });
+        for(int i = 0; i < 4; ++i) builds.push_back(session->BuildAsync(GetAddGraph(i)));
+
+        std::thread shutdown([&session] { session.reset(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        release.set_value();
+        shutdown.join();
+    }
+    for(int i = 0; i < 4; ++i)
+    {
+        ASSERT_EQ(builds[i].wait_for(std::chrono::seconds(0)), std::future_status::ready);
+        auto engine = builds[i].get();
+        engine->Stabilize(true);
+        ASSERT_EQ(engine->ReadObserver(engine->ResolveObserver("out")), double(i));
+    }
+}
+
+TEST(JitSession, QueuedLoadsFinishOnShutdown)
+{
+    JitEngineSlot slot;
+    std::promise<void> release;
+    std::vector<std::future<void>> loads;
+    {
+        std::unique_ptr<JitSession> session(new JitSession(1));
+        auto released = release.get_future().share();
+        session->Post([released] { released.wait(); });
+        for(int i = 0; i < 3; ++i) loads.push_back(slot.Load(GetAddGraph(i), *session));
+
+        std::thread shutdown([&session] { session.reset(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        release.set_value();
+        shutdown.join();
+    }
+    for(auto& load : loads)
+    {
+        ASSERT_EQ(load.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+        load.get();
+    }
+
+    // Loads run in order on the one thread so the last one is served
+    auto engine = slot.Get();
+    engine->Stabilize(true);
+    ASSERT_EQ(engine->ReadObserver(engine->ResolveObserver("out")), 2.0);
+}
+
+TEST(JitSession, SlotKeepsServingOldEngineWhileLoading)
+{
+    JitSession session(1);
+    JitEngineSlot slot;
+    slot.Load(GetAddGraph(1), session).get();
+    auto first = slot.Get();
+
+    auto load = slot.Load(GetAddGraph(2), session);
+    first->SetInput(first->ResolveInput("a"), 3.0);
+    first->Stabilize();
+    load.get();
+    ASSERT_EQ(first->ReadObserver(first->ResolveObserver("out")), 4.0);
+
+    auto second = slot.Get();
+    ASSERT_NE(first, second);
+    second->Stabilize(true);
+    ASSERT_EQ(second->ReadObserver(second->ResolveObserver("out")), 2.0);
+}
+
+}}
+#endif
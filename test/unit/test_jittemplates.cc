@@ -0,0 +1,154 @@
+#ifdef EXYS_JIT
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "jittemplates.h"
+
+namespace Exys {
+namespace test {
+
+const char* SUM_GRAPH = R"((begin
+    (input a)
+    (input b)
+    (observe "sum" (+ a b))
+))";
+
+const char* PRODUCT_GRAPH = R"((begin
+    (input a)
+    (input b)
+    (observe "product" (* a b))
+))";
+
+TEST(JitTemplateRegistry, ConcurrentInstantiateCompilesOnce)
+{
+    std::atomic<int> builds(0);
+    JitTemplateRegistry registry([&builds](const std::string& text)
+    {
+        ++builds;
+        // Long enough for the other threads to ask for it meanwhile
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return JitWrap::Build(text);
+    });
+
+    const int numThreads = 8;
+    std::vector<std::unique_ptr<JitWrap>> instances(numThreads);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            instances[t] = registry.Instantiate((t % 2) ? SUM_GRAPH : PRODUCT_GRAPH);
+        });
+    }
+    for(auto& thread : threads) thread.join();
+
+    ASSERT_EQ(builds, 2);
+    ASSERT_EQ(registry.GetNumTemplates(), 2u);
+
+    // Each instance has its own points
+    for(int t = 0; t < numThreads; ++t)
+    {
+        auto& instance = *instances[t];
+        instance.SetInput(instance.ResolveInput("a"), t);
+        instance.SetInput(instance.ResolveInput("b"), 2.0);
+        instance.Stabilize();
+    }
+    for(int t = 0; t < numThreads; ++t)
+    {
+        auto& instance = *instances[t];
+        const auto observer = instance.ResolveObserver((t % 2) ? "sum" : "product");
+        ASSERT_EQ(instance.ReadObserver(observer), (t % 2) ? t + 2.0 : t * 2.0);
+    }
+}
+
+TEST(JitTemplateRegistry, FailedCompileIsTriedAgain)
+{
+    int builds = 0;
+    JitTemplateRegistry registry([&builds](const std::string& text) -> std::unique_ptr<IEngine>
+    {
+        if(builds++ == 0) throw GraphBuildException("first build fails", Cell());
+        return JitWrap::Build(text);
+    });
+
+    ASSERT_THROW(registry.Instantiate(SUM_GRAPH), GraphBuildException);
+    ASSERT_EQ(registry.GetNumTemplates(), 0u);
+    ASSERT_TRUE(registry.Instantiate(SUM_GRAPH) != nullptr);
+    ASSERT_TRUE(registry.Instantiate(SUM_GRAPH) != nullptr);
+    ASSERT_EQ(builds, 2);
+}
+
+// The graph is removed and compiled again while its first compile is
+// still running. When that one fails it must leave the new entry be
+TEST(JitTemplateRegistry, FailedCompileLeavesNewerEntry)
+{
+    std::promise<void> started;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    std::atomic<int> builds(0);
+    JitTemplateRegistry registry([&](const std::string& text) -> std::unique_ptr<IEngine>
+    {
+        if(builds++ == 0)
+        {
+            started.set_value();
+            released.wait();
+            throw GraphBuildException("first build fails", Cell());
+        }
+        return JitWrap::Build(text);
+    });
+
+    auto failing = std::async(std::launch::async, [&] { return registry.Instantiate(SUM_GRAPH); });
+    started.get_future().wait();
+    registry.Remove(SUM_GRAPH);
+    auto instance = registry.Instantiate(SUM_GRAPH);
+    ASSERT_TRUE(instance != nullptr);
+
+    release.set_value();
+    ASSERT_THROW(failing.get(), GraphBuildException);
+    ASSERT_EQ(registry.GetNumTemplates(), 1u);
+
+    // Served from the newer entry without compiling again
+    ASSERT_TRUE(registry.Instantiate(SUM_GRAPH) != nullptr);
+    ASSERT_EQ(builds, 2);
+}
+
+TEST(JitTemplateRegistry, InstancesApplyBatches)
+{
+    JitTemplateRegistry registry;
+    std::vector<std::unique_ptr<JitWrap>> instances;
+    for(int i = 0; i < 4; ++i) instances.push_back(registry.Instantiate(SUM_GRAPH));
+
+    const auto a = instances[0]->ResolveInput("a");
+    const auto b = instances[0]->ResolveInput("b");
+    const auto sum = instances[0]->ResolveObserver("sum");
+    for(size_t i = 0; i < instances.size(); ++i)
+    {
+        const InputUpdate first[] = {{b, double(i)}};
+        const InputUpdate second[] = {{a, 10.0 + i}, {b, -1.0}, {b, 1.0}};
+        const InputUpdate third[] = {{b, 20.0 + i}};
+        instances[i]->ApplyBatch(first, 1);
+        ASSERT_EQ(instances[i]->ReadObserver(sum), i);
+        instances[i]->ApplyBatch(second, 3);
+        ASSERT_EQ(instances[i]->ReadObserver(sum), 11.0 + i);
+        instances[i]->ApplyBatch(third, 1);
+        ASSERT_EQ(instances[i]->ReadObserver(sum), 30.0 + 2 * i);
+    }
+
+    // A copy of an instance that has applied batches carries on from
+    // it. b was last stamped in the third batch so is the copy's
+    JitWrap copy(*instances[1]);
+    for(int i = 0; i < 2; ++i)
+    {
+        const InputUpdate update[] = {{a, double(i)}};
+        copy.ApplyBatch(update, 1);
+    }
+    const InputUpdate update[] = {{b, 5.0}};
+    copy.ApplyBatch(update, 1);
+    ASSERT_EQ(copy.ReadObserver(sum), 6.0);
+    ASSERT_EQ(instances[1]->ReadObserver(sum), 32.0);
+}
+
+}}
+#endif
@@ -0,0 +1,72 @@
+#ifdef EXYS_JIT
+#include <gtest/gtest.h>
+
+#include "jitwrap.h"
+
+namespace Exys {
+namespace test {
+
+const char* BATCH_GRAPH = R"((begin
+    (input a)
+    (input b)
+    (observe "sum" (+ a b))
+))";
+
+std::unique_ptr<JitWrap> BuildBatchEngine()
+{
+    auto engine = JitWrap::Build(BATCH_GRAPH);
+    return std::unique_ptr<JitWrap>(static_cast<JitWrap*>(engine.release()));
+}
+
+TEST(JitWrap, CopyAppliesFirstBatch)
+{
+    auto engine = BuildBatchEngine();
+    const auto a = engine->ResolveInput("a");
+    const auto b = engine->ResolveInput("b");
+    const auto sum = engine->ResolveObserver("sum");
+
+    // Stamps a and b with the source's current generation
+    const InputUpdate first[] = {{a, 5.0}, {b, 1.0}};
+    engine->ApplyBatch(first, 2);
+    ASSERT_EQ(engine->ReadObserver(sum), 6.0);
+
+    JitWrap copy(*engine);
+    const InputUpdate second[] = {{a, 7.0}};
+    copy.ApplyBatch(second, 1);
+    ASSERT_EQ(copy.ReadObserver(sum), 8.0);
+
+    // Each keeps batching on its own from there
+    const InputUpdate third[] = {{b, 2.0}, {a, 3.0}, {b, 4.0}};
+    copy.ApplyBatch(third, 3);
+    engine->ApplyBatch(second, 1);
+    ASSERT_EQ(copy.ReadObserver(sum), 7.0);
+    ASSERT_EQ(engine->ReadObserver(sum), 8.0);
+}
+
+TEST(JitWrap, CopyAppliesLaterBatches)
+{
+    auto engine = BuildBatchEngine();
+    const auto a = engine->ResolveInput("a");
+    const auto b = engine->ResolveInput("b");
+    const auto sum = engine->ResolveObserver("sum");
+
+    // The stamp left on b from the source's third batch must not
+    // match when the copy gets to its own third batch
+    for(int i = 0; i < 3; ++i)
+    {
+        const InputUpdate update[] = {{b, double(i)}};
+        engine->ApplyBatch(update, 1);
+    }
+    JitWrap copy(*engine);
+    const InputUpdate first[] = {{a, 1.0}};
+    const InputUpdate second[] = {{a, 2.0}};
+    const InputUpdate third[] = {{b, 10.0}};
+    copy.ApplyBatch(first, 1);
+    copy.ApplyBatch(second, 1);
+    copy.ApplyBatch(third, 1);
+    ASSERT_EQ(copy.ReadObserver(sum), 12.0);
+    ASSERT_EQ(engine->ReadObserver(sum), 2.0);
+}
+
+}}
+#endif
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "modulecache.h"
+#include "interpreter.h"
+
+namespace Exys {
+namespace test {
+
+const char* MODULE = R"((begin
+    (input module-in)
+    (define module-double (* module-in 2))
+    (provide module-in)
+    (provide module-double)
+))";
+
+// Each test gets its own module file and a cache cleared of it
+class ModuleCacheTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        char pattern[] = "/tmp/exys-module-XXXXXX";
+        ASSERT_TRUE(mkdtemp(pattern));
+        mDirectory = pattern;
+        mPath = mDirectory + "/module.exys";
+        WriteModule(MODULE);
+        ModuleCache::Get().Clear();
+    }
+
+    void TearDown() override
+    {
+        ModuleCache::Get().Clear();
+        std::remove(mPath.c_str());
+        rmdir(mDirectory.c_str());
+    }
+
+    void WriteModule(const std::string& text) const
+    {
+        std::ofstream out(mPath, std::ios::binary | std::ios::trunc);
+        out << text;
+    }
+
+    // Seconds since the epoch so the change never depends on how
+    // fine grained the file system's own times are
+    void SetModified(time_t seconds) const
+    {
+        const struct timespec times[2] = {{seconds, 0}, {seconds, 0}};
+        ASSERT_EQ(utimensat(AT_FDCWD, mPath.c_str(), times, 0), 0);
+    }
+
+    std::string mDirectory;
+    std::string mPath;
+};
+
+TEST_F(ModuleCacheTest, LoadsEachFileOnce)
+{
+    auto first = ModuleCache::Get().Load(mPath);
+    ASSERT_TRUE(first != nullptr);
+    ASSERT_EQ(ModuleCache::Get().Load(mPath).get(), first.get());
+
+    ModuleCache::Get().Clear();
+    auto cleared = ModuleCache::Get().Load(mPath);
+    ASSERT_TRUE(cleared != nullptr);
+    ASSERT_NE(cleared.get(), first.get());
+}
+
+TEST_F(ModuleCacheTest, MissingFile)
+{
+    ASSERT_TRUE(ModuleCache::Get().Load(mDirectory + "/missing.exys") == nullptr);
+}
+
+TEST_F(ModuleCacheTest, ParsedAgainWhenSizeChanges)
+{
+    SetModified(1000000);
+    auto first = ModuleCache::Get().Load(mPath);
+
+    // Same modification time so only the size tells them apart
+    WriteModule(std::string(MODULE) + "\n");
+    SetModified(1000000);
+    auto second = ModuleCache::Get().Load(mPath);
+    ASSERT_TRUE(second != nullptr);
+    ASSERT_NE(second.get(), first.get());
+    ASSERT_EQ(ModuleCache::Get().Load(mPath).get(), second.get());
+}
+
+TEST_F(ModuleCacheTest, ParsedAgainWhenModifiedChanges)
+{
+    SetModified(1000000);
+    auto first = ModuleCache::Get().Load(mPath);
+
+    // Same size so only the modification time tells them apart
+    std::string changed = MODULE;
+    changed.replace(changed.find("(* module-in 2)"), 15, "(* module-in 3)");
+    WriteModule(changed);
+    SetModified(1000000);
+    ASSERT_EQ(ModuleCache::Get().Load(mPath).get(), first.get());
+
+    SetModified(2000000);
+    auto second = ModuleCache::Get().Load(mPath);
+    ASSERT_TRUE(second != nullptr);
+    ASSERT_NE(second.get(), first.get());
+    ASSERT_EQ(ModuleCache::Get().Load(mPath).get(), second.get());
+
+    // The graph sees the new definition
+    auto engine = Interpreter::Build("(begin (require \"" + mPath + "\") (observe \"out\" module-double))");
+    engine->SetInput(engine->ResolveInput("module-in"), 2.0);
+    engine->Stabilize();
+    ASSERT_EQ(engine->ReadObserver(engine->ResolveObserver("out")), 6.0);
+}
+
+// Both requires get the same module graph so there is one input
+// behind module-in and both definitions hang off it
+TEST_F(ModuleCacheTest, RequiredTwiceSharesOneGraph)
+{
+    const auto require = "(require \"" + mPath + "\")";
+    auto engine = Interpreter::Build("(begin " + require + " (define first module-double) " + require +
+            " (observe \"first\" first) (observe \"second\" module-double))");
+
+    ASSERT_EQ(engine->GetInputPointLabels().size(), 1u);
+    engine->SetInput(engine->ResolveInput("module-in"), 4.0);
+    engine->Stabilize();
+    ASSERT_EQ(engine->ReadObserver(engine->ResolveObserver("first")), 8.0);
+    ASSERT_EQ(engine->ReadObserver(engine->ResolveObserver("second")), 8.0);
+}
+
+}}
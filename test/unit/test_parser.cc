@@ -3,7 +3,10 @@
 
 #include "parser.h"
 
-std::ostream& operator<<(std::ostream& s, Exys::TokenDetails const & d)
+namespace Exys {
+
+// In the namespace of TokenDetails so gtest messages find it
+std::ostream& operator<<(std::ostream& s, TokenDetails const & d)
 {
     s << "Token='" << d.text << "' (" 
         << d.firstLineNumber << ", " << d.firstColumn << ", "
@@ -11,7 +14,7 @@ std::ostream& operator<<(std::ostream& s, Exys::TokenDetails const & d)
     return s;
 }
 
-namespace Exys { namespace test {
+namespace test {
 
 bool operator==(const TokenDetails a, const TokenDetails b)
 {
@@ -163,7 +166,6 @@ std::pair<std::string, std::list<TokenDetails>> GenerateCommentedTokenString(std
 
 void CompareTokenDetails(std::list<TokenDetails>& expected, std::list<TokenDetails>& result)
 {
-    int i = 0;
     ASSERT_EQ(expected.size(), result.size());
     auto ei = expected.begin();
     auto ri = result.begin();
@@ -397,4 +399,112 @@ TEST(ReadFromTokenDetails, String_NotClosed)
                 ParseException);
 }
 
+// The root has no token so only its children are compared
+void CompareCells(const Cell& expected, const Cell& result)
+{
+    ASSERT_EQ(expected.type, result.type);
+    if(expected.type != Cell::Type::ROOT)
+    {
+        SCOPED_TRACE(::testing::Message() << "Comparing " << expected.details << " " << result.details);
+        ASSERT_TRUE(expected.details == result.details);
+    }
+    ASSERT_EQ(expected.list.size(), result.list.size());
+    for(size_t i = 0; i < expected.list.size(); i++)
+    {
+        CompareCells(expected.list[i], result.list[i]);
+    }
+}
+
+// Parse reads the tokens as it goes so check it builds
+// the same tree as the two steps
+void RunParseTest(std::string input)
+{
+    SCOPED_TRACE(::testing::Message() << "Input " << input);
+    auto expected = ReadFromTokenDetails(Tokenize(input));
+    auto result = Parse(input);
+    CompareCells(expected, result);
+}
+
+TEST(Parse, empty)
+{
+    auto cell = Parse("");
+    ASSERT_EQ(cell.type, Cell::Type::ROOT);
+    ASSERT_EQ(0, cell.list.size());
+}
+
+TEST(Parse, GeneralExample)
+{
+    RunParseTest(GenerateCompactTokenString(GetGeneralExample()).first);
+    RunParseTest(GenerateSpaceExpandedTokenString(GetGeneralExample()).first);
+    RunParseTest(GenerateNewlineExpandedTokenString(GetGeneralExample()).first);
+    RunParseTest(GenerateCommentedTokenString(GetGeneralExample()).first);
+}
+
+TEST(Parse, Nested)
+{
+    RunParseTest("(begin (define x (+ 1 (* 2 3))) (observe \"x\" x)) (test t (expect x 7))");
+}
+
+TEST(Parse, StringExample_EscapedChar)
+{
+    auto cell = Parse("(define teststr \"TEST\\\"TEST\")");
+    ASSERT_EQ(1, cell.list.size());
+    ASSERT_EQ(3, cell.list[0].list.size());
+    ASSERT_EQ(cell.list[0].list[2].type, Cell::Type::STRING);
+    ASSERT_EQ(cell.list[0].list[2].details.text, "TEST\"TEST");
+}
+
+TEST(Parse, Symbols)
+{
+    auto cell = Parse("(define x (+ x \"x\" 1))");
+    const auto& define = cell.list[0].list;
+    const auto& add = define[2].list;
+    ASSERT_EQ(define[0].symbol, SYMBOL_DEFINE);
+    ASSERT_EQ(add[0].symbol, SYMBOL_ADD);
+    ASSERT_NE(define[1].symbol, NO_SYMBOL);
+    ASSERT_EQ(define[1].symbol, add[1].symbol);
+    ASSERT_EQ(SymbolTable::Get().GetName(add[1].symbol), "x");
+    ASSERT_EQ(add[2].symbol, NO_SYMBOL);
+    ASSERT_EQ(add[3].symbol, NO_SYMBOL);
+}
+
+// The fixed ids are switched on so their names in symbol.cc
+// have to stay in the same order as the enum
+TEST(Parse, FixedSymbols)
+{
+    auto& table = SymbolTable::Get();
+    for(Symbol symbol = SYMBOL_BEGIN; symbol < NUM_FIXED_SYMBOLS; ++symbol)
+    {
+        ASSERT_EQ(table.Intern(table.GetName(symbol)), symbol);
+    }
+    ASSERT_EQ(table.Intern("sim-apply"), SYMBOL_SIM_APPLY);
+    ASSERT_EQ(table.Intern("rolling-max"), SYMBOL_ROLLING_MAX);
+    ASSERT_EQ(table.Intern(""), NO_SYMBOL);
+}
+
+TEST(Parse, SymbolsSurviveGrowth)
+{
+    auto& table = SymbolTable::Get();
+    std::vector<Symbol> symbols;
+    for(int i = 0; i < 5000; i++)
+    {
+        symbols.push_back(table.Intern("grow" + std::to_string(i)));
+    }
+    for(int i = 0; i < 5000; i++)
+    {
+        ASSERT_EQ(table.Intern("grow" + std::to_string(i)), symbols[i]);
+        ASSERT_EQ(table.GetName(symbols[i]), "grow" + std::to_string(i));
+    }
+    ASSERT_EQ(table.Intern("define"), SYMBOL_DEFINE);
+}
+
+TEST(Parse, Unbalanced)
+{
+    ASSERT_THROW(Parse("("), ParseException);
+    ASSERT_THROW(Parse(")"), ParseException);
+    ASSERT_THROW(Parse("(()"), ParseException);
+    ASSERT_THROW(Parse("())"), ParseException);
+    ASSERT_THROW(Parse("(\"abc)"), ParseException);
+}
+
 }}
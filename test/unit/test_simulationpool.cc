@@ -0,0 +1,154 @@
+#ifdef EXYS_JIT
+#include <gtest/gtest.h>
+
+#include "simulationpool.h"
+
+namespace Exys {
+namespace test {
+
+// Sim 0 counts up to the limit a step at a time so a job costs as
+// many steps as its limit. Sim 1 never finishes
+const char* POOL_GRAPH = R"((begin
+    (input count)
+    (input limit)
+    (input scale)
+    (observe count)
+    (observe "scaled" (* count scale))
+    (sim-apply count (+ count 1) (>= count limit))
+    (sim-apply count (+ count scale) 0)
+))";
+
+std::unique_ptr<JitWrap> BuildPoolEngine()
+{
+    auto engine = JitWrap::Build(POOL_GRAPH);
+    return std::unique_ptr<JitWrap>(static_cast<JitWrap*>(engine.release()));
+}
+
+// Same steps as SimulationPool::RunJob one job after another
+std::vector<SimulationResult> RunSerial(JitWrap& engine, const std::vector<SimulationJob>& jobs,
+        const std::vector<ObserverHandle>& observers, int maxSteps)
+{
+    std::vector<SimulationResult> results(jobs.size());
+    engine.CaptureState();
+    for(size_t i = 0; i < jobs.size(); ++i)
+    {
+        auto& result = results[i];
+        engine.ResetState();
+        for(const auto& update : jobs[i].mInputs)
+        {
+            engine.SetInput(update.mHandle, update.mVal);
+        }
+        engine.Stabilize();
+        for(int step = 0; step < maxSteps && !result.mDone; ++step)
+        {
+            result.mDone = engine.RunSimulationId(jobs[i].mSimId);
+        }
+        engine.Stabilize();
+        for(const auto& handle : observers)
+        {
+            result.mObservers.push_back(engine.ReadObserver(handle));
+        }
+    }
+    engine.ResetState();
+    return results;
+}
+
+// The first jobs are by far the longest so the threads dealt the
+// later ones run dry early and have to steal them
+std::vector<SimulationJob> GetJobs(JitWrap& engine, size_t count)
+{
+    const auto limit = engine.ResolveInput("limit");
+    const auto scale = engine.ResolveInput("scale");
+    std::vector<SimulationJob> jobs(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        auto& job = jobs[i];
+        job.mSimId = (i % 7 == 3) ? 1 : 0;
+        const double steps = (i < count / 4) ? 500.0 + i : double(i % 5);
+        job.mInputs.push_back({limit, steps});
+        job.mInputs.push_back({scale, 1.0 + (i % 3)});
+    }
+    return jobs;
+}
+
+void ExpectSameResults(const std::vector<SimulationResult>& pool, const std::vector<SimulationResult>& serial)
+{
+    ASSERT_EQ(pool.size(), serial.size());
+    for(size_t i = 0; i < pool.size(); ++i)
+    {
+        EXPECT_EQ(pool[i].mDone, serial[i].mDone) << "job " << i;
+        EXPECT_EQ(pool[i].mObservers, serial[i].mObservers) << "job " << i;
+    }
+}
+
+std::vector<ObserverHandle> GetObservers(JitWrap& engine)
+{
+    return {engine.ResolveObserver("count"), engine.ResolveObserver("scaled")};
+}
+
+TEST(SimulationPool, MoreJobsThanThreads)
+{
+    auto engine = BuildPoolEngine();
+    const auto observers = GetObservers(*engine);
+    const auto jobs = GetJobs(*engine, 203);
+
+    SimulationPool pool(*engine, 4);
+    const auto serial = RunSerial(*engine, jobs, observers, 1000);
+    ExpectSameResults(pool.Run(jobs, observers, 1000), serial);
+
+    // Capped jobs come back not done. Done is tested on the count
+    // before the step so finished ones go one past the limit
+    ASSERT_FALSE(serial[3].mDone);
+    ASSERT_TRUE(serial[0].mDone);
+    ASSERT_EQ(serial[0].mObservers[0], 501.0);
+}
+
+TEST(SimulationPool, StealsFromBusyThreads)
+{
+    auto engine = BuildPoolEngine();
+    const auto observers = GetObservers(*engine);
+
+    // One slow job a thread so most queues empty straight away
+    auto jobs = GetJobs(*engine, 64);
+    for(size_t i = 0; i < jobs.size(); i += 16) jobs[i].mInputs[0].mVal = 5000.0;
+
+    SimulationPool pool(*engine, 4);
+    const auto serial = RunSerial(*engine, jobs, observers, 10000);
+    for(int run = 0; run < 20; ++run)
+    {
+        ExpectSameResults(pool.Run(jobs, observers, 10000), serial);
+    }
+}
+
+TEST(SimulationPool, FewerJobsThanThreads)
+{
+    auto engine = BuildPoolEngine();
+    const auto observers = GetObservers(*engine);
+    SimulationPool pool(*engine, 8);
+
+    const auto jobs = GetJobs(*engine, 3);
+    ExpectSameResults(pool.Run(jobs, observers, 100), RunSerial(*engine, jobs, observers, 100));
+    ASSERT_TRUE(pool.Run({}, observers).empty());
+}
+
+TEST(SimulationPool, RunsFromCapturedState)
+{
+    auto engine = BuildPoolEngine();
+    const auto observers = GetObservers(*engine);
+    const auto jobs = GetJobs(*engine, 50);
+    SimulationPool pool(*engine, 3);
+
+    engine->SetInput(engine->ResolveInput("count"), 100.0);
+    engine->Stabilize();
+    const auto serial = RunSerial(*engine, jobs, observers, 1000);
+
+    // Still running from the state at construction
+    const auto stale = pool.Run(jobs, observers, 1000);
+    ASSERT_NE(stale[13].mObservers, serial[13].mObservers);
+
+    pool.CaptureState(*engine);
+    ExpectSameResults(pool.Run(jobs, observers, 1000), serial);
+}
+
+}}
+#endif
@@ -1,4 +1,5 @@
 
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -8,29 +9,84 @@
 #include "executioner.h"
 #include "interpreter.h"
 #include "jitwrap.h"
+#include "aotengine.h"
+#include "allocations.h"
+
+// Writes every element of every input with a stabilize after each and
+// a batch at the end, reading every observer as it goes. Two passes
+// warm the engine up and the allocations of the next two are returned
+uint64_t GetSteadyStateAllocations(Exys::IEngine& engine)
+{
+    std::vector<Exys::Point*> inputs;
+    std::vector<Exys::InputUpdate> batch;
+    for(const auto& label : engine.GetInputPointLabels())
+    {
+        // Members of input lists are written through the list
+        if(label.find('[') != std::string::npos) continue;
+        inputs.push_back(&engine.LookupInputPoint(label));
+        batch.push_back({engine.ResolveInput(label), 0.0});
+    }
+    std::vector<Exys::ObserverHandle> observers;
+    for(const auto& label : engine.GetObserverPointLabels())
+    {
+        observers.push_back(engine.ResolveObserver(label));
+    }
+    Exys::DumpedPoints dumped;
+
+    auto runPass = [&](double value)
+    {
+        for(auto input : inputs)
+        {
+            for(uint32_t i = 0; i < input->mLength; ++i)
+            {
+                (*input)[i] = value + i;
+                engine.Stabilize();
+                for(const auto& observer : observers) engine.ReadObserver(observer);
+            }
+        }
+        for(auto& update : batch) update.mVal = -value;
+        engine.ApplyBatch(batch.data(), batch.size());
+        engine.DumpInputs(dumped.inputs);
+        engine.DumpObservers(dumped.observers);
+    };
+
+    runPass(1.0);
+    runPass(2.0);
+    const auto before = GetAllocationCount();
+    runPass(3.0);
+    runPass(4.0);
+    return GetAllocationCount() - before;
+}
 
 int main(int argc, char* argv[])
 {
-    enum { INTERPRETER, JITTER, GPU } mode = INTERPRETER;
+    enum { INTERPRETER, JITTER, GPU, AOT } mode = INTERPRETER;
+    bool profile = false;
+    bool checkAllocations = false;
+    std::string library;
     
     int opt;
 
-    while ((opt = getopt(argc, argv, "ijg")) != -1) 
+    while ((opt = getopt(argc, argv, "ijgpal:")) != -1) 
     {
         switch (opt) 
         {
             case 'i': mode = INTERPRETER; break;
             case 'j': mode = JITTER; break;
             case 'g': mode = GPU; break;
+            case 'p': profile = true; break;
+            case 'a': checkAllocations = true; break;
+            case 'l': mode = AOT; library = optarg; break;
             default:
-                fprintf(stderr, "Usage: %s [-ijg] file\n", argv[0]);
+                fprintf(stderr, "Usage: %s [-ijg | -l library] [-p] [-a] file\n", argv[0]);
                 exit(EXIT_FAILURE);
         }
     }
 
-    if(optind > argc)
+    // A library holds one graph so it is checked against one file
+    if((optind > argc) || ((mode == AOT) && (argc - optind != 1)))
     {
-        fprintf(stderr, "Usage: %s [-ijg] file\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-ijg | -l library] [-p] [-a] file\n", argv[0]);
         exit(EXIT_FAILURE);
     }
     
@@ -53,11 +109,17 @@ int main(int argc, char* argv[])
             if(mode == INTERPRETER)
             {
                 engine = Exys::Interpreter::Build(buffer.str());
+                if(profile) static_cast<Exys::Interpreter&>(*engine).SetProfiling(true);
             }
 #ifdef EXYS_JIT
             else if(mode == JITTER)
             {
-                engine = Exys::JitWrap::Build(buffer.str());
+                engine = profile ? Exys::JitWrap::BuildProfiled(buffer.str()) :
+                    Exys::JitWrap::Build(buffer.str());
+            }
+            else if(mode == AOT)
+            {
+                engine = Exys::AotEngine::Load(library);
             }
 #endif
             else
@@ -66,7 +128,43 @@ int main(int argc, char* argv[])
             }
             auto results = Exys::Execute(*engine, buffer.str());
             std::cout << std::get<1>(results) << "\n";
+#ifdef EXYS_JIT
+            // Compiled ahead of time it should go through the
+            // same states as the jit does running the tests
+            if(mode == AOT)
+            {
+                auto jit = Exys::JitWrap::Build(buffer.str());
+                const auto differences = Exys::CompareStates(std::get<2>(results),
+                        std::get<2>(Exys::Execute(*jit, buffer.str())));
+                if(!differences.empty())
+                {
+                    std::cout << "Differs from the jit\n" << differences;
+                    ret = -1;
+                }
+            }
+#endif
+            if(profile && (mode == INTERPRETER))
+            {
+                std::cout << static_cast<Exys::Interpreter&>(*engine).GetProfileReport();
+            }
+#ifdef EXYS_JIT
+            else if(profile && (mode == JITTER))
+            {
+                std::cout << static_cast<Exys::JitWrap&>(*engine).GetProfileReport();
+            }
+#endif
             if(!std::get<0>(results)) ret = -1;
+
+            // Run after the tests so the engine has seen some inputs
+            if(checkAllocations)
+            {
+                const auto allocations = GetSteadyStateAllocations(*engine);
+                if(allocations)
+                {
+                    std::cout << "Allocated " << allocations << " times after warm up\n";
+                    ret = -1;
+                }
+            }
         }
         catch (const Exys::ParseException& e)
         {